@@ -0,0 +1,581 @@
+#pragma once
+
+#include <complex>
+#include <vector>
+#include <cmath>
+#include <type_traits>
+
+#include "Oscillator.h"
+
+namespace osc
+{
+    // -----------------------------------------------------------------------------------
+    // Radix-2 complex FFT of a fixed, power of two size. Twiddle factors and the bit
+    // reversal permutation are calculated once on construction.
+    // -----------------------------------------------------------------------------------
+    template<typename FloatType>
+    class FFT
+    {
+    public:
+        FFT() = delete;
+
+        // -------------------------------------------------------------------------------
+        // Constructor. Precalculates the twiddle factors and bit reversal table.
+        //
+        // Arguments:
+        //     _uSize - number of points, must be a power of two
+        // -------------------------------------------------------------------------------
+        FFT(size_t _uSize) :
+            m_uSize(_uSize),
+            m_vTwiddles(_uSize / 2),
+            m_vBitReverse(_uSize)
+        {
+            for (size_t i{ 0 }; i < m_vTwiddles.size(); ++i)
+                m_vTwiddles[i] = std::polar((FloatType)1.0, (FloatType)(2.0 * M_PI * i / _uSize));
+
+            size_t uBits{ 0 };
+            while (((size_t)1 << uBits) < _uSize)
+                ++uBits;
+
+            for (size_t i{ 0 }; i < _uSize; ++i)
+            {
+                size_t uReversed{ 0 };
+                for (size_t b{ 0 }; b < uBits; ++b)
+                    uReversed |= ((i >> b) & 1) << (uBits - 1 - b);
+                m_vBitReverse[i] = uReversed;
+            }
+        };
+
+        // -------------------------------------------------------------------------------
+        // Performs an in-place inverse transform, including the 1 / N scaling.
+        //
+        // Arguments:
+        //     _vData - spectrum of m_uSize bins, replaced by the time domain signal
+        //
+        // Returns:
+        //     void
+        // -------------------------------------------------------------------------------
+        void Inverse(std::vector<std::complex<FloatType>>& _vData) const
+        {
+            for (size_t i{ 0 }; i < m_uSize; ++i)
+                if (i < m_vBitReverse[i])
+                    std::swap(_vData[i], _vData[m_vBitReverse[i]]);
+
+            for (size_t uLength{ 2 }; uLength <= m_uSize; uLength <<= 1)
+            {
+                const size_t uHalf{ uLength / 2 }, uStride{ m_uSize / uLength };
+                for (size_t uStart{ 0 }; uStart < m_uSize; uStart += uLength)
+                {
+                    for (size_t k{ 0 }; k < uHalf; ++k)
+                    {
+                        const std::complex<FloatType> t{ m_vTwiddles[k * uStride] *
+                                                         _vData[uStart + k + uHalf] };
+                        _vData[uStart + k + uHalf] = _vData[uStart + k] - t;
+                        _vData[uStart + k] += t;
+                    }
+                }
+            }
+
+            const FloatType scale{ (FloatType)1.0 / m_uSize };
+            for (auto& x : _vData)
+                x *= scale;
+        }
+
+        size_t GetSize() const { return m_uSize; };
+
+    private:
+        const size_t m_uSize;
+        std::vector<std::complex<FloatType>> m_vTwiddles;
+        std::vector<size_t> m_vBitReverse;
+    };
+
+    // -----------------------------------------------------------------------------------
+    // A single sinusoid for FFTAdditiveEngine. Phase is the argument of sin() at the
+    // next sample to be produced.
+    // -----------------------------------------------------------------------------------
+    struct Partial
+    {
+        double frequency = 0.0;
+        double amplitude = 0.0;
+        double phase = 0.0;
+    };
+
+    // -----------------------------------------------------------------------------------
+    // FFTAdditiveEngine class. Synthesises the sum of many sinusoids by building the
+    // spectrum of each Hann windowed frame directly from the partials, inverse
+    // transforming it and overlap-adding frames at 50% overlap. Each partial only
+    // touches the few bins around its frequency. Its windowed kernel depends only on
+    // the frequency, so it is calculated once in SetPartials() and each frame just
+    // rotates it by the partial's phase. The cost per frame is the FFT plus a small,
+    // fixed cost per partial.
+    //
+    // Frequencies and amplitudes are constant between calls to SetPartials(). Partials
+    // at or above the nyquist limit are muted, matching SineWave.
+    // -----------------------------------------------------------------------------------
+    template<typename FloatType>
+    class FFTAdditiveEngine
+    {
+    public:
+        static_assert(std::is_same_v<float, FloatType>
+                      || std::is_same_v<double, FloatType>,
+            "FFTAdditiveEngine class template argument must be of type float or double");
+
+    public:
+        // Signal to noise ratio of FFT synthesis with the default kernel half width, in
+        // dB. Direct summation reaches about 185 dB for double and 130 dB for mixed
+        // precision.
+        static constexpr double FFT_SNR_DB = 80.0;
+
+        // Smallest number of partials FFT synthesis is used for, however cheap it is.
+        static constexpr size_t MIN_FFT_PARTIALS = 16;
+
+        // Default accuracy budget of ShouldUseFFT(). Double waves require more than FFT
+        // synthesis gives, so they stay on the direct path unless a caller lowers it.
+        static constexpr double DEFAULT_MIN_SNR_DB = std::is_same_v<double, FloatType> ? 120.0
+                                                                                        : 60.0;
+
+    public:
+        FFTAdditiveEngine() = delete;
+
+        // -------------------------------------------------------------------------------
+        // Constructor.
+        //
+        // Arguments:
+        //     _sampleRate       - audio sample rate in Hz
+        //     _uFrameSize       - FFT size, must be a power of two. Output is produced
+        //                         in hops of half this size
+        //     _uKernelHalfWidth - number of bins either side of each partial's peak that
+        //                         are written. Larger values reduce leakage error
+        // -------------------------------------------------------------------------------
+        FFTAdditiveEngine(FloatType _sampleRate,
+                          size_t _uFrameSize = 1024,
+                          size_t _uKernelHalfWidth = 16) :
+            m_SampleRate(_sampleRate),
+            m_uFrameSize(_uFrameSize),
+            m_uHopSize(_uFrameSize / 2),
+            m_uKernelHalfWidth(_uKernelHalfWidth),
+            m_FFT(_uFrameSize),
+            m_vSpectrum(_uFrameSize),
+            m_vAccumulator(_uFrameSize),
+            m_vReady(_uFrameSize / 2),
+            m_vDirichlet(2 * _uKernelHalfWidth + 3),
+            m_uReadPosition(_uFrameSize / 2) {};
+
+    public:
+        // -------------------------------------------------------------------------------
+        // Replaces the partials being synthesised and restarts synthesis from their
+        // phases.
+        //
+        // Arguments:
+        //     _vPartials - partials to synthesise
+        //
+        // Returns:
+        //     void
+        // -------------------------------------------------------------------------------
+        void SetPartials(const std::vector<Partial>& _vPartials)
+        {
+            m_vPartials = _vPartials;
+            BuildKernels();
+            Prime();
+        }
+
+        // -------------------------------------------------------------------------------
+        // Copies the frequency, amplitude and current phase of every SineWave in a
+        // ComplexWave, and restarts synthesis from there.
+        //
+        // Arguments:
+        //     _wave - ComplexWave to synthesise
+        //
+        // Returns:
+        //     void
+        // -------------------------------------------------------------------------------
+        template<typename PhaseType>
+        void SetPartials(const ComplexWave<FloatType, PhaseType>& _wave)
+        {
+            m_vPartials.clear();
+            m_vPartials.reserve(_wave.GetSines().size());
+            for (auto& s : _wave.GetSines())
+                m_vPartials.push_back({ s.GetFrequency(), s.GetAmplitude(), s.GetPhase() });
+
+            BuildKernels();
+            Prime();
+        }
+
+        size_t GetNumPartials() const { return m_vPartials.size(); };
+
+        // -------------------------------------------------------------------------------
+        // Returns the phase of a partial at the next sample to be output. The stored
+        // phases are those at the end of the hop being read.
+        //
+        // Arguments:
+        //     _uPartial - index of the partial
+        //
+        // Returns:
+        //     phase in the range [0, 2 * pi)
+        // -------------------------------------------------------------------------------
+        double GetPhase(size_t _uPartial) const
+        {
+            const Partial& partial{ m_vPartials[_uPartial] };
+            const double phase{ partial.phase - TWO_PI * partial.frequency *
+                                (double)(m_uHopSize - m_uReadPosition) / m_SampleRate };
+
+            return phase - TWO_PI * std::floor(phase / TWO_PI);
+        }
+
+        size_t GetFrameSize() const { return m_uFrameSize; };
+        size_t GetKernelHalfWidth() const { return m_uKernelHalfWidth; };
+        FloatType GetSampleRate() const { return m_SampleRate; };
+
+        // -------------------------------------------------------------------------------
+        // Writes the next _uNumSamples sample values into _pOutput, synthesising new
+        // frames as required.
+        //
+        // Arguments:
+        //     _pOutput     - buffer of at least _uNumSamples values
+        //     _uNumSamples - number of samples to render
+        //
+        // Returns:
+        //     state of the rendered block
+        // -------------------------------------------------------------------------------
+        BlockState NextBlock(FloatType* _pOutput, size_t _uNumSamples)
+        {
+            BlockState state{ BlockState::Silent };
+            size_t uWritten{ 0 };
+            while (uWritten < _uNumSamples)
+            {
+                if (m_uReadPosition == m_uHopSize)
+                {
+                    SynthesiseFrame();
+                    m_uReadPosition = 0;
+                }
+
+                const size_t uCount{ std::min(m_uHopSize - m_uReadPosition,
+                                              _uNumSamples - uWritten) };
+                if (m_bReadySilent)
+                    std::fill(_pOutput + uWritten, _pOutput + uWritten + uCount,
+                              (FloatType)0.0);
+                else
+                {
+                    std::copy(m_vReady.begin() + m_uReadPosition,
+                              m_vReady.begin() + m_uReadPosition + uCount,
+                              _pOutput + uWritten);
+                    state = BlockState::Signal;
+                }
+
+                m_uReadPosition += uCount;
+                uWritten += uCount;
+            }
+
+            return state;
+        }
+
+        // -------------------------------------------------------------------------------
+        // Decides whether FFT synthesis should replace summing SineWaves directly. FFT
+        // synthesis trades accuracy for speed: it is only chosen for at least
+        // MIN_FFT_PARTIALS partials, if FFT_SNR_DB meets _minSnrDb, and if it is
+        // estimated to be cheaper.
+        //
+        // Costs are in nanoseconds and were measured against ComplexWave::NextBlock()
+        // with AVX2. Float and mixed precision waves use the vectorised block path and
+        // break even at about 25 partials, double waves use scalar sin() and break even
+        // at 2.
+        //
+        // Arguments:
+        //     _uNumPartials     - number of partials to be synthesised
+        //     _uFrameSize       - FFT size of the engine
+        //     _uKernelHalfWidth - bins either side of each partial's peak
+        //     _minSnrDb         - lowest acceptable signal to noise ratio in dB
+        //
+        // Returns:
+        //     true if FFT synthesis is accurate enough and expected to be faster
+        // -------------------------------------------------------------------------------
+        template<typename PhaseType = FloatType>
+        static bool ShouldUseFFT(size_t _uNumPartials,
+                                 size_t _uFrameSize = 1024,
+                                 size_t _uKernelHalfWidth = 16,
+                                 double _minSnrDb = DEFAULT_MIN_SNR_DB)
+        {
+            static_assert(std::is_same_v<float, PhaseType>
+                          || std::is_same_v<double, PhaseType>,
+                "ShouldUseFFT template argument must be of type float or double");
+
+            if (_uNumPartials < MIN_FFT_PARTIALS || _minSnrDb > FFT_SNR_DB)
+                return false;
+
+            const double frameSize{ (double)_uFrameSize };
+            const double hopSize{ frameSize / 2.0 };
+
+            const double sampleCost{ std::is_same_v<double, FloatType>  ? DOUBLE_SAMPLE_COST
+                                     : std::is_same_v<double, PhaseType> ? MIXED_SAMPLE_COST
+                                                                         : FLOAT_SAMPLE_COST };
+            const double directCost{ _uNumPartials * hopSize * sampleCost };
+            const double fftCost{ FFT_POINT_COST * frameSize * std::log2(frameSize) +
+                                  _uNumPartials * (PARTIAL_COST +
+                                                   BIN_COST * (2.0 * _uKernelHalfWidth + 1.0)) };
+
+            return fftCost < directCost;
+        }
+
+    private:
+        // -------------------------------------------------------------------------------
+        // Clears the overlap-add state and synthesises the frame starting one hop before
+        // the current position, so the first hop of output is fully overlapped.
+        // -------------------------------------------------------------------------------
+        void Prime()
+        {
+            std::fill(m_vAccumulator.begin(), m_vAccumulator.end(), (FloatType)0.0);
+            m_bPreviousAudible = false;
+
+            AdvancePartials(-(double)m_uHopSize);
+            SynthesiseFrame();
+            m_uReadPosition = m_uHopSize;
+        }
+
+        // -------------------------------------------------------------------------------
+        // Moves each partial's phase by a number of samples, wrapped to [0, 2 * pi).
+        // -------------------------------------------------------------------------------
+        void AdvancePartials(double _numSamples)
+        {
+            for (auto& p : m_vPartials)
+            {
+                p.phase += TWO_PI * p.frequency * _numSamples / m_SampleRate;
+                p.phase -= TWO_PI * std::floor(p.phase / TWO_PI);
+            }
+        }
+
+        // -------------------------------------------------------------------------------
+        // Builds the spectrum of the next frame, inverse transforms it, overlap-adds it
+        // into m_vAccumulator and moves the completed hop into m_vReady. If no partial is
+        // audible the FFT is skipped, and the hop is silent once the previous frame's
+        // tail has also been output.
+        // -------------------------------------------------------------------------------
+        void SynthesiseFrame()
+        {
+            const bool bAudible{ !m_vAudible.empty() };
+            if (bAudible)
+            {
+                std::fill(m_vSpectrum.begin(), m_vSpectrum.end(), std::complex<FloatType>{});
+
+                for (size_t i{ 0 }; i < m_vAudible.size(); ++i)
+                    AddPartialToSpectrum(i);
+
+                m_FFT.Inverse(m_vSpectrum);
+
+                for (size_t i{ 0 }; i < m_uFrameSize; ++i)
+                    m_vAccumulator[i] += m_vSpectrum[i].real();
+            }
+
+            m_bReadySilent = !bAudible && !m_bPreviousAudible;
+            m_bPreviousAudible = bAudible;
+
+            std::copy(m_vAccumulator.begin(), m_vAccumulator.begin() + m_uHopSize,
+                      m_vReady.begin());
+            std::copy(m_vAccumulator.begin() + m_uHopSize, m_vAccumulator.end(),
+                      m_vAccumulator.begin());
+            std::fill(m_vAccumulator.begin() + m_uHopSize, m_vAccumulator.end(),
+                      (FloatType)0.0);
+
+            AdvancePartials((double)m_uHopSize);
+        }
+
+        // -------------------------------------------------------------------------------
+        // Calculates the spectrum of every audible partial with a phase of 0, scaled by
+        // its amplitude, for the bins around its peak.
+        //
+        // The DFT of w[n] * e^(i * (2 * pi * b * n / N + phi)), with w the periodic Hann
+        // window and b the (fractional) bin of the partial, is at bin k
+        //     e^(i * phi) * (D(d) / 2 - D(d + 1) / 4 - D(d - 1) / 4),   d = b - k
+        // where D is the Dirichlet kernel
+        //     D(d) = e^(i * pi * d * (N - 1) / N) * sin(pi * d) / sin(pi * d / N).
+        // Scaling by -i * amplitude makes the real part of the inverse transform equal
+        // amplitude * sin(), so the negative frequency image is not needed.
+        // -------------------------------------------------------------------------------
+        void BuildKernels()
+        {
+            const double N{ (double)m_uFrameSize };
+            const long long halfWidth{ (long long)m_uKernelHalfWidth };
+
+            m_vAudible.clear();
+            m_vCentres.clear();
+            m_vKernels.clear();
+            for (size_t p{ 0 }; p < m_vPartials.size(); ++p)
+            {
+                const Partial& partial{ m_vPartials[p] };
+                if (partial.frequency >= m_SampleRate / 2.0 || partial.amplitude == 0.0)
+                    continue;
+
+                const double bin{ partial.frequency * N / m_SampleRate };
+                const long long centre{ (long long)std::llround(bin) };
+
+                // D(d) for d = d0 + j. sin(pi * d) alternates sign as d steps by one, and
+                // both the leading phase term and sin(pi * d / N) are stepped by
+                // rotation, so each partial needs only a handful of trig calls.
+                const double d0{ bin - centre - halfWidth - 1 };
+                double sinPiD{ std::sin(M_PI * d0) };
+                double rotRe{ std::cos(M_PI * d0 * (N - 1.0) / N) };
+                double rotIm{ std::sin(M_PI * d0 * (N - 1.0) / N) };
+                const double stepRe{ std::cos(M_PI * (N - 1.0) / N) };
+                const double stepIm{ std::sin(M_PI * (N - 1.0) / N) };
+                double denSin{ std::sin(M_PI * d0 / N) }, denCos{ std::cos(M_PI * d0 / N) };
+                const double denStepSin{ std::sin(M_PI / N) }, denStepCos{ std::cos(M_PI / N) };
+                for (size_t j{ 0 }; j < m_vDirichlet.size(); ++j)
+                {
+                    const double magnitude{ std::abs(denSin) < 1e-12 ? N : sinPiD / denSin };
+                    m_vDirichlet[j] = { rotRe * magnitude, rotIm * magnitude };
+
+                    sinPiD = -sinPiD;
+                    const double nextRotRe{ rotRe * stepRe - rotIm * stepIm };
+                    rotIm = rotRe * stepIm + rotIm * stepRe;
+                    rotRe = nextRotRe;
+                    const double nextDenSin{ denSin * denStepCos + denCos * denStepSin };
+                    denCos = denCos * denStepCos - denSin * denStepSin;
+                    denSin = nextDenSin;
+                }
+
+                // Bin k = centre + m has d = bin - centre - m, which is entry
+                // halfWidth + 1 - m of m_vDirichlet.
+                for (long long m{ -halfWidth }; m <= halfWidth; ++m)
+                {
+                    const size_t j{ (size_t)(halfWidth + 1 - m) };
+                    const std::complex<double> kernel{ 0.5 * m_vDirichlet[j] -
+                                                       0.25 * m_vDirichlet[j + 1] -
+                                                       0.25 * m_vDirichlet[j - 1] };
+                    m_vKernels.push_back((std::complex<FloatType>)(partial.amplitude * kernel));
+                }
+
+                m_vAudible.push_back(p);
+                m_vCentres.push_back(centre);
+            }
+        }
+
+        // -------------------------------------------------------------------------------
+        // Adds the precalculated kernel of an audible partial to the spectrum, rotated by
+        // -i * e^(i * phase).
+        // -------------------------------------------------------------------------------
+        void AddPartialToSpectrum(size_t _uAudible)
+        {
+            const size_t uKernelSize{ 2 * m_uKernelHalfWidth + 1 };
+            const double phase{ m_vPartials[m_vAudible[_uAudible]].phase };
+            const FloatType scaleRe{ (FloatType)std::sin(phase) };
+            const FloatType scaleIm{ (FloatType)-std::cos(phase) };
+            const std::complex<FloatType>* pKernel{ &m_vKernels[_uAudible * uKernelSize] };
+
+            // The frame size is a power of two, so masking wraps negative bins too.
+            const size_t uFirst{ (size_t)(m_vCentres[_uAudible] - (long long)m_uKernelHalfWidth) };
+            for (size_t m{ 0 }; m < uKernelSize; ++m)
+            {
+                const FloatType valueRe{ scaleRe * pKernel[m].real() - scaleIm * pKernel[m].imag() };
+                const FloatType valueIm{ scaleRe * pKernel[m].imag() + scaleIm * pKernel[m].real() };
+                m_vSpectrum[(uFirst + m) & (m_uFrameSize - 1)] += std::complex<FloatType>(valueRe, valueIm);
+            }
+        }
+
+    private:
+        const FloatType m_SampleRate;
+        const size_t m_uFrameSize;
+        const size_t m_uHopSize;
+        const size_t m_uKernelHalfWidth;
+
+        FFT<FloatType> m_FFT;
+        std::vector<Partial> m_vPartials;
+        std::vector<std::complex<FloatType>> m_vSpectrum;
+        std::vector<FloatType> m_vAccumulator;
+        std::vector<FloatType> m_vReady;
+        std::vector<std::complex<double>> m_vDirichlet;
+        std::vector<size_t> m_vAudible;
+        std::vector<long long> m_vCentres;
+        std::vector<std::complex<FloatType>> m_vKernels;
+        size_t m_uReadPosition;
+        bool m_bReadySilent = true;
+        bool m_bPreviousAudible = false;
+
+    private:
+        static constexpr double TWO_PI = 2 * M_PI;
+        static constexpr double FLOAT_SAMPLE_COST = 1.3;
+        static constexpr double MIXED_SAMPLE_COST = 1.4;
+        static constexpr double DOUBLE_SAMPLE_COST = 17.0;
+        static constexpr double FFT_POINT_COST = 1.4;
+        static constexpr double PARTIAL_COST = 20.0;
+        static constexpr double BIN_COST = 1.5;
+    };
+
+    // -----------------------------------------------------------------------------------
+    // AdditiveRenderer class. Renders a ComplexWave either by direct summation with
+    // ComplexWave::NextBlock() or with an FFTAdditiveEngine, whichever
+    // FFTAdditiveEngine::ShouldUseFFT() estimates to be cheaper for its number of
+    // partials within the renderer's accuracy budget. The FFT path is about 80 dB SNR,
+    // so by default only float renderers use it; double renderers opt in by passing a
+    // lower _minSnrDb. The ComplexWave's phases are kept up to date in both cases.
+    // -----------------------------------------------------------------------------------
+    template<typename FloatType, typename PhaseType = FloatType>
+    class AdditiveRenderer
+    {
+    public:
+        AdditiveRenderer() = delete;
+
+        // -------------------------------------------------------------------------------
+        // Constructor.
+        //
+        // Arguments:
+        //     _wave       - ComplexWave to render. Must outlive the renderer
+        //     _uFrameSize - FFT size used if FFT synthesis is chosen
+        //     _minSnrDb   - lowest signal to noise ratio accepted from FFT synthesis
+        // -------------------------------------------------------------------------------
+        AdditiveRenderer(ComplexWave<FloatType, PhaseType>& _wave,
+                         size_t _uFrameSize = 1024,
+                         double _minSnrDb = FFTAdditiveEngine<FloatType>::DEFAULT_MIN_SNR_DB) :
+            m_Wave(_wave),
+            m_Engine(_wave.GetSampleRate(), _uFrameSize),
+            m_MinSnrDb(_minSnrDb)
+        {
+            Update();
+        };
+
+    public:
+        // -------------------------------------------------------------------------------
+        // Must be called after changing the frequency, amplitude or number of harmonics
+        // of the ComplexWave. Re-evaluates which method is cheaper and restarts FFT
+        // synthesis from the wave's current phases.
+        //
+        // Returns:
+        //     void
+        // -------------------------------------------------------------------------------
+        void Update()
+        {
+            m_bUseFFT = FFTAdditiveEngine<FloatType>::template ShouldUseFFT<PhaseType>(
+                m_Wave.GetSines().size(), m_Engine.GetFrameSize(),
+                m_Engine.GetKernelHalfWidth(), m_MinSnrDb);
+
+            if (m_bUseFFT)
+                m_Engine.SetPartials(m_Wave);
+        }
+
+        // -------------------------------------------------------------------------------
+        // Writes the next _uNumSamples sample values into _pOutput.
+        //
+        // Arguments:
+        //     _pOutput     - buffer of at least _uNumSamples values
+        //     _uNumSamples - number of samples to render
+        //
+        // Returns:
+        //     state of the rendered block
+        // -------------------------------------------------------------------------------
+        BlockState NextBlock(FloatType* _pOutput, size_t _uNumSamples)
+        {
+            if (!m_bUseFFT)
+                return m_Wave.NextBlock(_pOutput, _uNumSamples);
+
+            m_Wave.AdvancePhase(_uNumSamples);
+            return m_Engine.NextBlock(_pOutput, _uNumSamples);
+        }
+
+        ComplexWave<FloatType, PhaseType>& GetWave() { return m_Wave; };
+        bool IsUsingFFT() const { return m_bUseFFT; };
+
+    private:
+        ComplexWave<FloatType, PhaseType>& m_Wave;
+        FFTAdditiveEngine<FloatType> m_Engine;
+        const double m_MinSnrDb;
+        bool m_bUseFFT = false;
+    };
+}
@@ -0,0 +1,414 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <istream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "CycleCache.h"
+#include "Oscillator.h"
+
+namespace osc
+{
+    // -----------------------------------------------------------------------------------
+    // One signal to render. waveform is "sine" or "square". If sweepFrequency is above 0
+    // the frequency moves exponentially from frequency to sweepFrequency over the job.
+    // Sweeps are rendered as a staircase: the frequency is recalculated at every
+    // multiple of 64 samples (BatchRenderer::SWEEP_STEP) and held in between.
+    // -----------------------------------------------------------------------------------
+    struct RenderJob
+    {
+        std::string name;
+        std::string waveform;
+        double sampleRate = 44100.0;
+        double frequency = 0.0;
+        double amplitude = 1.0;
+        size_t uNumHarmonics = 0;
+        size_t uNumSamples = 0;
+        std::string outputPath;
+        double sweepFrequency = 0.0;
+    };
+
+    // -----------------------------------------------------------------------------------
+    // Throughput of one rendered job. Jobs with the same parameters as an earlier job are
+    // copied from its output rather than rendered, and have bReused set. Jobs writing to
+    // the same output as an earlier job with different parameters are not rendered, and
+    // have bSucceeded cleared.
+    // -----------------------------------------------------------------------------------
+    struct JobReport
+    {
+        std::string name;
+        size_t uNumSamples = 0;
+        double seconds = 0.0;
+        double samplesPerSecond = 0.0;
+        bool bReused = false;
+        bool bSucceeded = false;
+    };
+
+    // -----------------------------------------------------------------------------------
+    // Parses a manifest field holding a real number. The whole field must be used.
+    // -----------------------------------------------------------------------------------
+    inline bool ParseManifestNumber(const std::string& _field, double& _value)
+    {
+        std::istringstream stream(_field);
+        return (stream >> _value) && (stream >> std::ws).eof() && std::isfinite(_value);
+    }
+
+    // -----------------------------------------------------------------------------------
+    // Parses a manifest field holding a count. Streams accept a leading '-' for
+    // unsigned values and wrap it around, so only fields starting with a digit are
+    // accepted.
+    // -----------------------------------------------------------------------------------
+    inline bool ParseManifestCount(const std::string& _field, size_t& _uValue)
+    {
+        if (_field.empty() || !std::isdigit((unsigned char)_field.front()))
+            return false;
+
+        std::istringstream stream(_field);
+        return (stream >> _uValue) && (stream >> std::ws).eof();
+    }
+
+    // -----------------------------------------------------------------------------------
+    // Reads render jobs from a manifest. Each line holds one job as whitespace separated
+    // fields:
+    //     name waveform sampleRate frequency amplitude numHarmonics numSamples output
+    //     [sweepFrequency]
+    // Blank lines and lines starting with '#' are skipped. sampleRate must be above 0,
+    // frequency and sweepFrequency must not be negative, and numHarmonics and
+    // numSamples must be whole numbers.
+    //
+    // Arguments:
+    //     _input  - manifest to read
+    //     _vJobs  - vector the jobs are appended to
+    //     _error  - set to a description of the first invalid line
+    //
+    // Returns:
+    //     true if every line was valid
+    // -----------------------------------------------------------------------------------
+    inline bool ParseManifest(std::istream& _input,
+                              std::vector<RenderJob>& _vJobs,
+                              std::string& _error)
+    {
+        std::string line;
+        for (size_t uLine{ 1 }; std::getline(_input, line); ++uLine)
+        {
+            std::istringstream stream(line);
+            std::vector<std::string> vFields;
+            for (std::string field; stream >> field;)
+                vFields.push_back(field);
+
+            if (vFields.empty() || vFields.front().front() == '#')
+                continue;
+
+            const std::string prefix{ "line " + std::to_string(uLine) + ": " };
+            if (vFields.size() < 8)
+            {
+                _error = prefix + "expected 8 fields";
+                return false;
+            }
+            if (vFields.size() > 9)
+            {
+                _error = prefix + "unexpected field " + vFields[9];
+                return false;
+            }
+
+            RenderJob job;
+            job.name = vFields[0];
+            job.waveform = vFields[1];
+            job.outputPath = vFields[7];
+
+            if (job.waveform != "sine" && job.waveform != "square")
+            {
+                _error = prefix + "unknown waveform " + job.waveform;
+                return false;
+            }
+            if (!ParseManifestNumber(vFields[2], job.sampleRate) || !(job.sampleRate > 0.0))
+            {
+                _error = prefix + "invalid sampleRate " + vFields[2];
+                return false;
+            }
+            if (!ParseManifestNumber(vFields[3], job.frequency) || job.frequency < 0.0)
+            {
+                _error = prefix + "invalid frequency " + vFields[3];
+                return false;
+            }
+            if (!ParseManifestNumber(vFields[4], job.amplitude))
+            {
+                _error = prefix + "invalid amplitude " + vFields[4];
+                return false;
+            }
+            if (!ParseManifestCount(vFields[5], job.uNumHarmonics))
+            {
+                _error = prefix + "invalid numHarmonics " + vFields[5];
+                return false;
+            }
+            if (!ParseManifestCount(vFields[6], job.uNumSamples))
+            {
+                _error = prefix + "invalid numSamples " + vFields[6];
+                return false;
+            }
+            if (vFields.size() == 9 && (!ParseManifestNumber(vFields[8], job.sweepFrequency) ||
+                                        job.sweepFrequency < 0.0))
+            {
+                _error = prefix + "invalid sweepFrequency " + vFields[8];
+                return false;
+            }
+
+            _vJobs.push_back(job);
+        }
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------
+    // BatchRenderer class. Renders a list of jobs across a pool of threads, streaming
+    // each job to its output file in blocks of m_uBlockSize samples, so memory use does
+    // not depend on the job lengths. Output files hold raw FloatType samples in native
+    // byte order.
+    //
+    // Phase is accumulated in double whatever FloatType is, so long float jobs do not
+    // drift in pitch.
+    //
+    // Jobs with identical parameters are rendered once and copied to the other outputs.
+    // Steady tones are replayed through a CycleCache shared by all threads, so jobs with
+    // the same tone but different lengths share one rendered period.
+    // -----------------------------------------------------------------------------------
+    template<typename FloatType>
+    class BatchRenderer
+    {
+    public:
+        static constexpr size_t SWEEP_STEP = 64;
+
+    public:
+        // -------------------------------------------------------------------------------
+        // Constructor.
+        //
+        // Arguments:
+        //     _uNumThreads - number of worker threads, 0 for one per hardware thread
+        //     _uBlockSize  - number of samples rendered and written at a time
+        // -------------------------------------------------------------------------------
+        BatchRenderer(size_t _uNumThreads = 0, size_t _uBlockSize = 4096) :
+            m_uNumThreads(_uNumThreads ? _uNumThreads
+                                       : std::max(1u, std::thread::hardware_concurrency())),
+            m_uBlockSize(std::max<size_t>(_uBlockSize, 1)) {};
+
+    public:
+        // -------------------------------------------------------------------------------
+        // Renders every job and waits for them to finish.
+        //
+        // Arguments:
+        //     _vJobs - jobs to render
+        //
+        // Returns:
+        //     a report for each job, in the same order as _vJobs
+        // -------------------------------------------------------------------------------
+        std::vector<JobReport> Run(const std::vector<RenderJob>& _vJobs)
+        {
+            std::vector<JobReport> vReports(_vJobs.size());
+            const std::vector<std::vector<size_t>> vGroups{ GroupJobs(_vJobs, vReports) };
+
+            std::atomic<size_t> uNextGroup{ 0 };
+            auto worker = [&]() {
+                for (size_t g{ uNextGroup++ }; g < vGroups.size(); g = uNextGroup++)
+                    RenderGroup(_vJobs, vGroups[g], vReports);
+            };
+
+            std::vector<std::thread> vThreads;
+            const size_t uNumThreads{ std::min(m_uNumThreads, vGroups.size()) };
+            for (size_t i{ 0 }; i < uNumThreads; ++i)
+                vThreads.emplace_back(worker);
+
+            for (auto& t : vThreads)
+                t.join();
+
+            return vReports;
+        }
+
+        CycleCache<FloatType>& GetCycleCache() { return m_Cache; };
+
+    private:
+        // -------------------------------------------------------------------------------
+        // Collects the indices of jobs with identical parameters, in order of first use.
+        // A job whose output is already written by another group would race with it, so
+        // it is left out and reported as failed.
+        // -------------------------------------------------------------------------------
+        static std::vector<std::vector<size_t>> GroupJobs(const std::vector<RenderJob>& _vJobs,
+                                                          std::vector<JobReport>& _vReports)
+        {
+            using Key = std::tuple<std::string, double, double, double, size_t, size_t, double>;
+
+            std::map<Key, size_t> mGroupIndices;
+            std::map<std::filesystem::path, size_t> mOutputGroups;
+            std::vector<std::vector<size_t>> vGroups;
+            for (size_t i{ 0 }; i < _vJobs.size(); ++i)
+            {
+                const RenderJob& job{ _vJobs[i] };
+                const Key key{ job.waveform, job.sampleRate, job.frequency, job.amplitude,
+                               job.waveform == "square" ? job.uNumHarmonics : 0,
+                               job.uNumSamples, job.sweepFrequency };
+
+                auto it{ mGroupIndices.find(key) };
+                const size_t uGroup{ it != mGroupIndices.end() ? it->second : vGroups.size() };
+
+                std::error_code error;
+                const std::filesystem::path output{
+                    std::filesystem::absolute(job.outputPath, error).lexically_normal() };
+                auto [outputIt, bNewOutput] = mOutputGroups.insert({ output, uGroup });
+                if (!bNewOutput && outputIt->second != uGroup)
+                {
+                    _vReports[i].name = job.name;
+                    _vReports[i].uNumSamples = job.uNumSamples;
+                    continue;
+                }
+
+                if (it == mGroupIndices.end())
+                {
+                    mGroupIndices.insert({ key, uGroup });
+                    vGroups.emplace_back();
+                }
+                vGroups[uGroup].push_back(i);
+            }
+
+            return vGroups;
+        }
+
+        // -------------------------------------------------------------------------------
+        // Renders the first job of a group, then copies its output to the others.
+        // -------------------------------------------------------------------------------
+        void RenderGroup(const std::vector<RenderJob>& _vJobs,
+                         const std::vector<size_t>& _vGroup,
+                         std::vector<JobReport>& _vReports)
+        {
+            const RenderJob& source{ _vJobs[_vGroup.front()] };
+            _vReports[_vGroup.front()] = Measure(source, false, [&]() {
+                return RenderJobToFile(source);
+            });
+
+            for (auto it{ _vGroup.begin() + 1 }; it != _vGroup.end(); ++it)
+            {
+                const RenderJob& job{ _vJobs[*it] };
+                _vReports[*it] = Measure(job, true, [&]() {
+                    if (!_vReports[_vGroup.front()].bSucceeded)
+                        return false;
+                    if (job.outputPath == source.outputPath)
+                        return true;
+
+                    std::error_code error;
+                    std::filesystem::copy_file(source.outputPath, job.outputPath,
+                        std::filesystem::copy_options::overwrite_existing, error);
+                    return !error;
+                });
+            }
+        }
+
+        template<typename Function>
+        static JobReport Measure(const RenderJob& _job, bool _bReused, Function _function)
+        {
+            const auto start{ std::chrono::steady_clock::now() };
+            const bool bSucceeded{ _function() };
+            const std::chrono::duration<double> elapsed{ std::chrono::steady_clock::now() - start };
+
+            JobReport report;
+            report.name = _job.name;
+            report.uNumSamples = _job.uNumSamples;
+            report.seconds = elapsed.count();
+            report.samplesPerSecond = report.seconds > 0.0 ? _job.uNumSamples / report.seconds : 0.0;
+            report.bReused = _bReused;
+            report.bSucceeded = bSucceeded;
+
+            return report;
+        }
+
+        bool RenderJobToFile(const RenderJob& _job)
+        {
+            std::ofstream os(_job.outputPath, std::ios::binary);
+            if (!os.is_open())
+                return false;
+
+            const FloatType sampleRate{ (FloatType)_job.sampleRate };
+            const FloatType frequency{ (FloatType)_job.frequency };
+            const FloatType amplitude{ (FloatType)_job.amplitude };
+
+            if (_job.waveform == "square")
+            {
+                SquareWave<FloatType, double> wave(sampleRate, frequency, amplitude,
+                                                   _job.uNumHarmonics);
+                Stream(wave, _job, os);
+            }
+            else
+            {
+                SineWave<FloatType, double> wave(sampleRate, frequency, amplitude);
+                Stream(wave, _job, os);
+            }
+
+            // Closing flushes the last buffered samples, which can fail too.
+            os.close();
+            return (bool)os;
+        }
+
+        // -------------------------------------------------------------------------------
+        // Renders a job block by block into an output stream. Sweeps update the
+        // frequency every SWEEP_STEP samples and hold it in between, steady tones are
+        // replayed from the cache.
+        // -------------------------------------------------------------------------------
+        template<typename WaveType>
+        void Stream(WaveType& _wave, const RenderJob& _job, std::ostream& _os)
+        {
+            std::vector<FloatType> vBlock(m_uBlockSize);
+            auto write = [&](size_t _uCount) {
+                _os.write(reinterpret_cast<const char*>(vBlock.data()),
+                          _uCount * sizeof(FloatType));
+            };
+
+            if (!(_job.sweepFrequency > 0.0 && _job.frequency > 0.0))
+            {
+                CachedWave<FloatType, WaveType> cached(_wave, m_Cache);
+                for (size_t uDone{ 0 }; uDone < _job.uNumSamples; uDone += vBlock.size())
+                {
+                    const size_t uCount{ std::min(vBlock.size(), _job.uNumSamples - uDone) };
+                    cached.NextBlock(vBlock.data(), uCount);
+                    write(uCount);
+                }
+                return;
+            }
+
+            // Steps fall on multiples of SWEEP_STEP of the whole job, not of each block.
+            const double sweepRatio{ _job.sweepFrequency / _job.frequency };
+            for (size_t uDone{ 0 }; uDone < _job.uNumSamples; uDone += vBlock.size())
+            {
+                const size_t uCount{ std::min(vBlock.size(), _job.uNumSamples - uDone) };
+                for (size_t i{ 0 }; i < uCount;)
+                {
+                    const size_t uSample{ uDone + i };
+                    if (uSample % SWEEP_STEP == 0)
+                    {
+                        const double position{ (double)uSample / _job.uNumSamples };
+                        _wave.SetFrequency(
+                            (FloatType)(_job.frequency * std::pow(sweepRatio, position)));
+                    }
+
+                    const size_t uRun{ std::min(SWEEP_STEP - uSample % SWEEP_STEP,
+                                                uCount - i) };
+                    _wave.NextBlock(vBlock.data() + i, uRun);
+                    i += uRun;
+                }
+                write(uCount);
+            }
+        }
+
+    private:
+        const size_t m_uNumThreads;
+        const size_t m_uBlockSize;
+        CycleCache<FloatType> m_Cache;
+    };
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+namespace osc
+{
+    // -----------------------------------------------------------------------------------
+    // Describes the content of a rendered block. Returned by the NextBlock() methods so
+    // that downstream processing can skip work. The samples in a block are always valid,
+    // so ignoring the state is safe: a Silent block holds zeros and a Constant block
+    // holds the same value in every sample.
+    // -----------------------------------------------------------------------------------
+    enum class BlockState
+    {
+        Signal,
+        Constant,
+        Silent
+    };
+
+    // -----------------------------------------------------------------------------------
+    // Returns the state of the sum of two blocks.
+    // -----------------------------------------------------------------------------------
+    inline BlockState CombineStates(BlockState _a, BlockState _b)
+    {
+        if (_a == BlockState::Silent) return _b;
+        if (_b == BlockState::Silent) return _a;
+        if (_a == BlockState::Constant && _b == BlockState::Constant)
+            return BlockState::Constant;
+
+        return BlockState::Signal;
+    }
+
+    // -----------------------------------------------------------------------------------
+    // Returns the state of a block made of two consecutive runs. Two constant runs may
+    // hold different values, so only matching silent or signal runs keep their state.
+    // -----------------------------------------------------------------------------------
+    inline BlockState AppendStates(BlockState _first, BlockState _second)
+    {
+        if (_first == _second && _first != BlockState::Constant)
+            return _first;
+
+        return BlockState::Signal;
+    }
+
+    // -----------------------------------------------------------------------------------
+    // Adds a block, scaled by a gain, into a mix buffer. Silent inputs are skipped, and
+    // a silent mix buffer is overwritten rather than added to.
+    //
+    // Arguments:
+    //     _pOutput      - mix buffer of at least _uNumSamples values
+    //     _outputState  - state of the mix buffer so far
+    //     _pInput       - block to add
+    //     _inputState   - state of _pInput
+    //     _uNumSamples  - number of samples in each block
+    //     _gain         - gain applied to _pInput
+    //
+    // Returns:
+    //     state of the mix buffer after adding _pInput
+    // -----------------------------------------------------------------------------------
+    template<typename FloatType>
+    BlockState MixBlock(FloatType* _pOutput,
+                        BlockState _outputState,
+                        const FloatType* _pInput,
+                        BlockState _inputState,
+                        size_t _uNumSamples,
+                        FloatType _gain = 1.0)
+    {
+        if (_inputState == BlockState::Silent || _gain == 0.0)
+            return _outputState;
+
+        if (_outputState == BlockState::Silent)
+        {
+            for (size_t i{ 0 }; i < _uNumSamples; ++i)
+                _pOutput[i] = _gain * _pInput[i];
+
+            return _inputState;
+        }
+
+        for (size_t i{ 0 }; i < _uNumSamples; ++i)
+            _pOutput[i] += _gain * _pInput[i];
+
+        return CombineStates(_outputState, _inputState);
+    }
+
+    // -----------------------------------------------------------------------------------
+    // Converts a block of samples between -1.0 and 1.0 into integer PCM samples,
+    // clipping anything out of range. Silent and constant blocks are filled without
+    // converting each sample.
+    //
+    // Arguments:
+    //     _pInput      - block of at least _uNumSamples values
+    //     _state       - state of _pInput
+    //     _pOutput     - buffer of at least _uNumSamples PCM samples
+    //     _uNumSamples - number of samples to convert
+    //
+    // Returns:
+    //     void
+    // -----------------------------------------------------------------------------------
+    template<typename SampleType, typename FloatType>
+    void ConvertBlock(const FloatType* _pInput,
+                      BlockState _state,
+                      SampleType* _pOutput,
+                      size_t _uNumSamples)
+    {
+        static_assert(std::is_integral_v<SampleType>,
+            "ConvertBlock output must be an integer sample type");
+
+        constexpr FloatType maxSample{ (FloatType)std::numeric_limits<SampleType>::max() };
+        auto convert = [&](FloatType _sample) {
+            return (SampleType)(std::clamp(_sample, (FloatType)-1.0, (FloatType)1.0) * maxSample);
+        };
+
+        if (_uNumSamples == 0)
+            return;
+
+        if (_state == BlockState::Silent)
+            std::fill(_pOutput, _pOutput + _uNumSamples, (SampleType)0);
+        else if (_state == BlockState::Constant)
+            std::fill(_pOutput, _pOutput + _uNumSamples, convert(_pInput[0]));
+        else
+            for (size_t i{ 0 }; i < _uNumSamples; ++i)
+                _pOutput[i] = convert(_pInput[i]);
+    }
+}
@@ -0,0 +1,457 @@
+#pragma once
+
+#include <cmath>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <typeindex>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#include "Oscillator.h"
+
+namespace osc
+{
+    // -----------------------------------------------------------------------------------
+    // Number of cycles and samples in one exact repeat of a tone, i.e. the frequency is
+    // (approximately) uNumCycles * sampleRate / uNumSamples. uNumSamples is 0 if no
+    // repeat was found.
+    // -----------------------------------------------------------------------------------
+    struct Period
+    {
+        size_t uNumCycles = 0;
+        size_t uNumSamples = 0;
+    };
+
+    // -----------------------------------------------------------------------------------
+    // Finds the shortest whole number of samples after which a tone repeats, using the
+    // continued fraction expansion of _frequency / _sampleRate. For example a 1 kHz tone
+    // at 44.1 kHz repeats every 441 samples, after 10 cycles.
+    //
+    // Arguments:
+    //     _frequency       - frequency of the tone in Hz
+    //     _sampleRate      - audio sample rate in Hz
+    //     _tolerance       - largest accepted relative error in the repeated frequency
+    //     _uMaxNumSamples  - longest period accepted
+    //
+    // Returns:
+    //     the period, or an empty Period if none is within the limits
+    // -----------------------------------------------------------------------------------
+    inline Period FindPeriod(double _frequency,
+                             double _sampleRate,
+                             double _tolerance,
+                             size_t _uMaxNumSamples)
+    {
+        const double ratio{ _frequency / _sampleRate };
+        if (!(ratio > 0.0) || ratio >= 0.5)
+            return {};
+
+        // Convergents h / k of the continued fraction of ratio.
+        unsigned long long h{ 1 }, hPrev{ 0 }, k{ 0 }, kPrev{ 1 };
+        double remainder{ ratio };
+        for (size_t i{ 0 }; i < 64; ++i)
+        {
+            const double term{ std::floor(remainder) };
+            if (term > (double)_uMaxNumSamples)
+                break;
+
+            const unsigned long long a{ (unsigned long long)term };
+            const unsigned long long hNext{ a * h + hPrev }, kNext{ a * k + kPrev };
+            if (kNext > _uMaxNumSamples)
+                break;
+
+            hPrev = h; h = hNext;
+            kPrev = k; k = kNext;
+
+            if (h > 0 && std::abs((double)h / k - ratio) <= _tolerance * ratio)
+                return { (size_t)h, (size_t)k };
+
+            const double fraction{ remainder - term };
+            if (fraction == 0.0)
+                break;
+            remainder = 1.0 / fraction;
+        }
+
+        return {};
+    }
+
+    // -----------------------------------------------------------------------------------
+    // Identifies a rendered cycle. Two waves with equal keys produce identical samples.
+    // -----------------------------------------------------------------------------------
+    struct CycleKey
+    {
+        std::type_index waveform = typeid(void);
+        size_t uNumHarmonics = 0;
+        double frequency = 0.0;
+        double amplitude = 0.0;
+        double sampleRate = 0.0;
+
+        bool operator<(const CycleKey& _other) const
+        {
+            return std::tie(waveform, uNumHarmonics, frequency, amplitude, sampleRate) <
+                   std::tie(_other.waveform, _other.uNumHarmonics, _other.frequency,
+                            _other.amplitude, _other.sampleRate);
+        }
+
+        bool operator==(const CycleKey& _other) const
+        {
+            return !(*this < _other) && !(_other < *this);
+        }
+    };
+
+    // -----------------------------------------------------------------------------------
+    // Everything needed to render and replay a cycle of a wave: its key, the phase of
+    // its fundamental, and the harmonic number and amplitude of each audible partial.
+    // bHarmonic is false if any partial is not a whole multiple of the fundamental, in
+    // which case the wave cannot be cached.
+    // -----------------------------------------------------------------------------------
+    struct CycleDescription
+    {
+        CycleKey key;
+        double fundamentalPhase = 0.0;
+        std::vector<std::pair<size_t, double>> vHarmonics;
+        bool bHarmonic = true;
+    };
+
+    // -----------------------------------------------------------------------------------
+    // Adds a SineWave to a CycleDescription as a harmonic of _fundamental.
+    // -----------------------------------------------------------------------------------
+    template<typename FloatType, typename PhaseType>
+    void AddHarmonic(CycleDescription& _description,
+                     const SineWave<FloatType, PhaseType>& _sine,
+                     double _fundamental)
+    {
+        if (_sine.IsSilent())
+            return;
+
+        const double multiple{ _sine.GetFrequency() / _fundamental };
+        const double rounded{ std::round(multiple) };
+        if (rounded < 1.0 || std::abs(multiple - rounded) > 1e-9 * rounded)
+        {
+            _description.bHarmonic = false;
+            return;
+        }
+
+        _description.vHarmonics.push_back({ (size_t)rounded, _sine.GetAmplitude() });
+    }
+
+    // -----------------------------------------------------------------------------------
+    // Returns the CycleKey of a wave. Unlike DescribeCycle() this does not allocate, so
+    // it is cheap enough to check on every block.
+    // -----------------------------------------------------------------------------------
+    template<typename FloatType, typename PhaseType>
+    CycleKey MakeCycleKey(const SineWave<FloatType, PhaseType>& _sine)
+    {
+        return { typeid(_sine), 0, _sine.GetFrequency(), _sine.GetAmplitude(),
+                 _sine.GetSampleRate() };
+    }
+
+    template<typename FloatType, typename PhaseType>
+    CycleKey MakeCycleKey(const ComplexWave<FloatType, PhaseType>& _wave)
+    {
+        return { typeid(_wave), _wave.GetNumHarmonics(), _wave.GetFrequency(),
+                 _wave.GetAmplitude(), _wave.GetSampleRate() };
+    }
+
+    template<typename FloatType, typename PhaseType>
+    CycleDescription DescribeCycle(const SineWave<FloatType, PhaseType>& _sine)
+    {
+        CycleDescription description;
+        description.key = MakeCycleKey(_sine);
+        description.fundamentalPhase = _sine.GetPhase();
+        AddHarmonic(description, _sine, _sine.GetFrequency());
+
+        return description;
+    }
+
+    template<typename FloatType, typename PhaseType>
+    CycleDescription DescribeCycle(const ComplexWave<FloatType, PhaseType>& _wave)
+    {
+        CycleDescription description;
+        description.key = MakeCycleKey(_wave);
+        description.fundamentalPhase = _wave.GetSines().front().GetPhase();
+        for (auto& s : _wave.GetSines())
+            AddHarmonic(description, s, _wave.GetFrequency());
+
+        return description;
+    }
+
+    // -----------------------------------------------------------------------------------
+    // CycleCache class. Stores one exact period of steady-state tones so they can be
+    // replayed instead of recalculated. Buffers are shared between every CachedWave with
+    // the same CycleKey, and are freed once the last user releases them. Their entries
+    // are erased by the next Acquire(). Safe to use from several threads: periods are
+    // rendered outside the lock, and threads wanting a period that is being rendered
+    // wait for that one rather than rendering it again.
+    // -----------------------------------------------------------------------------------
+    template<typename FloatType>
+    class CycleCache
+    {
+    public:
+        using Buffer = std::shared_ptr<const std::vector<FloatType>>;
+
+        // -------------------------------------------------------------------------------
+        // A cached period. pSamples holds uNumCycles cycles of the wave, starting at a
+        // fundamental phase of 0.
+        // -------------------------------------------------------------------------------
+        struct Cycle
+        {
+            Buffer pSamples;
+            size_t uNumCycles = 0;
+        };
+
+    public:
+        // -------------------------------------------------------------------------------
+        // Constructor.
+        //
+        // Arguments:
+        //     _tolerance      - largest accepted relative error in the replayed frequency
+        //     _uMaxNumSamples - longest period that will be cached
+        // -------------------------------------------------------------------------------
+        CycleCache(double _tolerance = 1e-9, size_t _uMaxNumSamples = 65536) :
+            m_Tolerance(_tolerance),
+            m_uMaxNumSamples(_uMaxNumSamples) {};
+
+    public:
+        // -------------------------------------------------------------------------------
+        // Returns the cached period for a wave, rendering it if no other user holds it.
+        // Replay can only start on one of the period's samples, so a wave whose
+        // fundamental phase lies between them, by more than the tolerance of a cycle, is
+        // not cached.
+        //
+        // Arguments:
+        //     _description - description of the wave, from DescribeCycle()
+        //
+        // Returns:
+        //     the period, or an empty Cycle if the wave does not repeat within the limits
+        //     or its phase is off the period's sample grid
+        // -------------------------------------------------------------------------------
+        Cycle Acquire(const CycleDescription& _description)
+        {
+            if (!_description.bHarmonic || _description.vHarmonics.empty())
+                return {};
+
+            const Period period{ FindPeriod(_description.key.frequency,
+                                            _description.key.sampleRate,
+                                            m_Tolerance,
+                                            m_uMaxNumSamples) };
+            if (period.uNumSamples == 0)
+                return {};
+
+            const double position{ _description.fundamentalPhase * period.uNumSamples /
+                                   (2.0 * M_PI) };
+            if (std::abs(position - std::round(position)) > m_Tolerance * period.uNumSamples)
+                return {};
+
+            std::promise<Buffer> promise;
+            std::shared_future<Buffer> future;
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+
+                for (auto it{ m_mCycles.begin() }; it != m_mCycles.end();)
+                    it = it->second.IsExpired() ? m_mCycles.erase(it) : std::next(it);
+
+                Entry& entry{ m_mCycles[_description.key] };
+                if (entry.rendering.valid())
+                    future = entry.rendering;
+                else if (Buffer pSamples{ entry.pSamples.lock() })
+                    return { pSamples, period.uNumCycles };
+                else
+                    entry.rendering = promise.get_future().share();
+            }
+
+            if (future.valid())
+                return { future.get(), period.uNumCycles };
+
+            Buffer pSamples{ Render(_description, period) };
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+
+                // Entries being rendered are never erased, so this is still ours.
+                Entry& entry{ m_mCycles[_description.key] };
+                entry.pSamples = pSamples;
+                entry.rendering = {};
+            }
+            promise.set_value(pSamples);
+
+            return { pSamples, period.uNumCycles };
+        }
+
+        // -------------------------------------------------------------------------------
+        // Returns the number of periods currently held by at least one user.
+        // -------------------------------------------------------------------------------
+        size_t GetNumEntries()
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+
+            size_t uCount{ 0 };
+            for (auto& [key, entry] : m_mCycles)
+                uCount += !entry.pSamples.expired();
+
+            return uCount;
+        }
+
+    private:
+        // -------------------------------------------------------------------------------
+        // A period in the map. rendering is valid while the first user renders it, and
+        // pSamples is set once it is published.
+        // -------------------------------------------------------------------------------
+        struct Entry
+        {
+            std::weak_ptr<const std::vector<FloatType>> pSamples;
+            std::shared_future<Buffer> rendering;
+
+            bool IsExpired() const { return !rendering.valid() && pSamples.expired(); };
+        };
+
+    private:
+        // -------------------------------------------------------------------------------
+        // Renders one period. The phase of every sample is calculated exactly from its
+        // index, so the period joins onto itself without a discontinuity.
+        // -------------------------------------------------------------------------------
+        static Buffer Render(const CycleDescription& _description, const Period& _period)
+        {
+            const unsigned long long q{ _period.uNumSamples }, p{ _period.uNumCycles };
+            auto pSamples{ std::make_shared<std::vector<FloatType>>(_period.uNumSamples) };
+
+            for (unsigned long long i{ 0 }; i < q; ++i)
+            {
+                double sample{ 0.0 };
+                for (auto& [uHarmonic, amplitude] : _description.vHarmonics)
+                {
+                    const unsigned long long uIndex{ (uHarmonic * i * p) % q };
+                    sample += amplitude * std::sin(2.0 * M_PI * (double)uIndex / q);
+                }
+                (*pSamples)[i] = (FloatType)sample;
+            }
+
+            return pSamples;
+        }
+
+    private:
+        const double m_Tolerance;
+        const size_t m_uMaxNumSamples;
+
+        std::mutex m_Mutex;
+        std::map<CycleKey, Entry> m_mCycles;
+    };
+
+    // -----------------------------------------------------------------------------------
+    // CachedWave class. Opt-in wrapper that replays a SineWave or ComplexWave from a
+    // CycleCache while its frequency, amplitude and number of harmonics stay the same.
+    // The wrapped wave's phase is still advanced, in O(1) per block, so rendering
+    // continues seamlessly if the parameters change or the tone cannot be cached.
+    //
+    // Replay starts from the sample of the period matching the wave's current phase. A
+    // wave whose phase is off the period's sample grid, for example after a frequency
+    // change mid-cycle, is rendered directly until its parameters change again.
+    // Partials are assumed to be in harmonic phase alignment, as they are when a wave
+    // is constructed.
+    // -----------------------------------------------------------------------------------
+    template<typename FloatType, typename WaveType>
+    class CachedWave
+    {
+    public:
+        CachedWave() = delete;
+
+        // -------------------------------------------------------------------------------
+        // Constructor.
+        //
+        // Arguments:
+        //     _wave  - wave to render. Must outlive the CachedWave
+        //     _cache - cache to share periods through. Must outlive the CachedWave
+        // -------------------------------------------------------------------------------
+        CachedWave(WaveType& _wave, CycleCache<FloatType>& _cache) :
+            m_Wave(_wave),
+            m_Cache(_cache)
+        {
+            Refresh();
+        };
+
+    public:
+        // -------------------------------------------------------------------------------
+        // Writes the next _uNumSamples sample values into _pOutput, copying from the
+        // cached period if there is one.
+        //
+        // Arguments:
+        //     _pOutput     - buffer of at least _uNumSamples values
+        //     _uNumSamples - number of samples to render
+        //
+        // Returns:
+        //     state of the rendered block
+        // -------------------------------------------------------------------------------
+        BlockState NextBlock(FloatType* _pOutput, size_t _uNumSamples)
+        {
+            if (!(MakeCycleKey(m_Wave) == m_Key))
+                Refresh();
+
+            if (!m_Cycle.pSamples)
+                return m_Wave.NextBlock(_pOutput, _uNumSamples);
+
+            const std::vector<FloatType>& vSamples{ *m_Cycle.pSamples };
+            size_t uWritten{ 0 };
+            while (uWritten < _uNumSamples)
+            {
+                const size_t uCount{ std::min(vSamples.size() - m_uPosition,
+                                              _uNumSamples - uWritten) };
+                std::copy(vSamples.begin() + m_uPosition,
+                          vSamples.begin() + m_uPosition + uCount,
+                          _pOutput + uWritten);
+
+                uWritten += uCount;
+                m_uPosition = (m_uPosition + uCount) % vSamples.size();
+            }
+
+            m_Wave.AdvancePhase(_uNumSamples);
+            return BlockState::Signal;
+        }
+
+        WaveType& GetWave() { return m_Wave; };
+        bool IsCached() const { return (bool)m_Cycle.pSamples; };
+
+    private:
+        // -------------------------------------------------------------------------------
+        // Looks up the period for the wave's current parameters and finds the sample in
+        // it matching the wave's phase. Sample i of the period has a fundamental phase of
+        // 2 * pi * (i * uNumCycles mod uNumSamples) / uNumSamples, so the position is
+        // found with the modular inverse of uNumCycles.
+        // -------------------------------------------------------------------------------
+        void Refresh()
+        {
+            const CycleDescription description{ DescribeCycle(m_Wave) };
+            m_Key = description.key;
+            m_Cycle = m_Cache.Acquire(description);
+            m_uPosition = 0;
+
+            if (!m_Cycle.pSamples)
+                return;
+
+            const long long q{ (long long)m_Cycle.pSamples->size() };
+            const long long p{ (long long)m_Cycle.uNumCycles };
+            const long long m{ ((long long)std::llround(description.fundamentalPhase * q /
+                                                        (2.0 * M_PI)) % q + q) % q };
+
+            // Extended Euclid for the inverse of p modulo q.
+            long long r0{ q }, r1{ p % q }, t0{ 0 }, t1{ 1 };
+            while (r1 != 0)
+            {
+                const long long quotient{ r0 / r1 };
+                std::tie(r0, r1) = std::make_pair(r1, r0 - quotient * r1);
+                std::tie(t0, t1) = std::make_pair(t1, t0 - quotient * t1);
+            }
+            const long long inverse{ (t0 % q + q) % q };
+
+            m_uPosition = (size_t)((m * inverse) % q);
+        }
+
+    private:
+        WaveType& m_Wave;
+        CycleCache<FloatType>& m_Cache;
+        CycleKey m_Key;
+        typename CycleCache<FloatType>::Cycle m_Cycle;
+        size_t m_uPosition = 0;
+    };
+}
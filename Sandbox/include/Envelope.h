@@ -0,0 +1,357 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+#include "Block.h"
+
+namespace osc
+{
+    // -----------------------------------------------------------------------------------
+    // Envelope class. ADSR envelope with exponential segments, applied to blocks of
+    // samples. Each segment approaches an overshoot target by the recurrence
+    //     level[n + 1] = target + (level[n] - target) * coefficient
+    // which is evaluated LANES samples at a time from precalculated powers of the
+    // coefficient, so the lanes are independent and the loop can be vectorised.
+    // Once the release has decayed below IDLE_LEVEL the envelope is idle, and voices
+    // using it can skip rendering entirely until the next NoteOn().
+    // -----------------------------------------------------------------------------------
+    template<typename FloatType>
+    class Envelope
+    {
+    public:
+        static_assert(std::is_same_v<float, FloatType>
+                      || std::is_same_v<double, FloatType>,
+            "Envelope class template argument must be of type float or double");
+
+        enum class Stage
+        {
+            Idle,
+            Attack,
+            Decay,
+            Sustain,
+            Release
+        };
+
+    private:
+        static constexpr size_t LANES = 8;
+        static constexpr FloatType ATTACK_RATIO = 0.3;
+        static constexpr FloatType DECAY_RATIO = 0.0001;
+        static constexpr FloatType IDLE_LEVEL = 0.00001;
+
+        // -------------------------------------------------------------------------------
+        // Coefficient and its powers for one exponential segment.
+        // -------------------------------------------------------------------------------
+        struct Segment
+        {
+            FloatType coefficient = 0.0;
+            FloatType ratio = 0.0;
+            FloatType vPowers[LANES + 1] = {};
+        };
+
+    public:
+        Envelope() = delete;
+
+        // -------------------------------------------------------------------------------
+        // Constructor. Times are in seconds, the sustain level is a gain.
+        //
+        // Arguments:
+        //     _sampleRate - audio sample rate in Hz
+        //     _attack     - time to rise from 0 to 1
+        //     _decay      - time to fall from 1 to the sustain level
+        //     _sustain    - level held while the note is on
+        //     _release    - time to fall from the sustain level to silence
+        // -------------------------------------------------------------------------------
+        Envelope(FloatType _sampleRate,
+                 FloatType _attack = 0.01,
+                 FloatType _decay = 0.1,
+                 FloatType _sustain = 0.7,
+                 FloatType _release = 0.3) :
+            m_SampleRate(_sampleRate),
+            m_Sustain(_sustain)
+        {
+            SetAttack(_attack);
+            SetDecay(_decay);
+            SetRelease(_release);
+        };
+
+    public:
+        void SetAttack(FloatType _seconds) { m_Attack = MakeSegment(_seconds, ATTACK_RATIO); };
+        void SetDecay(FloatType _seconds) { m_Decay = MakeSegment(_seconds, DECAY_RATIO); };
+        void SetSustain(FloatType _level) { m_Sustain = _level; };
+        void SetRelease(FloatType _seconds) { m_Release = MakeSegment(_seconds, DECAY_RATIO); };
+
+        void NoteOn() { m_Stage = Stage::Attack; };
+        void NoteOff()
+        {
+            if (m_Stage != Stage::Idle)
+                m_Stage = Stage::Release;
+        };
+
+        Stage GetStage() const { return m_Stage; };
+        FloatType GetLevel() const { return m_Level; };
+        bool IsIdle() const { return m_Stage == Stage::Idle; };
+
+        // -------------------------------------------------------------------------------
+        // Multiplies a block of samples by the envelope, moving through the stages as
+        // their end levels are reached. Silent blocks are not touched, the envelope is
+        // only advanced.
+        //
+        // Arguments:
+        //     _pBuffer     - samples to apply the envelope to, in place
+        //     _uNumSamples - number of samples in _pBuffer
+        //     _state       - state of the samples in _pBuffer
+        //
+        // Returns:
+        //     state of the block after the envelope is applied
+        // -------------------------------------------------------------------------------
+        BlockState ProcessBlock(FloatType* _pBuffer,
+                                size_t _uNumSamples,
+                                BlockState _state = BlockState::Signal)
+        {
+            if (_state == BlockState::Silent)
+            {
+                Advance(_uNumSamples);
+                return BlockState::Silent;
+            }
+
+            if (m_Stage == Stage::Idle)
+            {
+                std::fill(_pBuffer, _pBuffer + _uNumSamples, (FloatType)0.0);
+                return BlockState::Silent;
+            }
+
+            const bool bHeld{ m_Stage == Stage::Sustain };
+            Run(_pBuffer, _uNumSamples);
+
+            if (bHeld && m_Sustain == 0.0)
+                return BlockState::Silent;
+
+            return bHeld ? _state : BlockState::Signal;
+        }
+
+        // -------------------------------------------------------------------------------
+        // Moves the envelope forward by _uNumSamples samples without a buffer, in O(1)
+        // per stage.
+        //
+        // Arguments:
+        //     _uNumSamples - number of samples to skip
+        //
+        // Returns:
+        //     void
+        // -------------------------------------------------------------------------------
+        void Advance(size_t _uNumSamples)
+        {
+            Run(nullptr, _uNumSamples);
+        }
+
+    private:
+        // -------------------------------------------------------------------------------
+        // Moves through the stages for _uNumSamples samples, multiplying _pBuffer by the
+        // envelope if it is not null.
+        // -------------------------------------------------------------------------------
+        void Run(FloatType* _pBuffer, size_t _uNumSamples)
+        {
+            size_t uDone{ 0 };
+            while (uDone < _uNumSamples)
+            {
+                const size_t uRemaining{ _uNumSamples - uDone };
+                FloatType* pRun{ _pBuffer ? _pBuffer + uDone : nullptr };
+
+                if (m_Stage == Stage::Idle)
+                {
+                    if (pRun)
+                        std::fill(pRun, pRun + uRemaining, (FloatType)0.0);
+                    return;
+                }
+
+                if (m_Stage == Stage::Sustain)
+                {
+                    m_Level = m_Sustain;
+                    if (pRun)
+                        for (size_t i{ 0 }; i < uRemaining; ++i)
+                            pRun[i] *= m_Level;
+                    return;
+                }
+
+                const Segment& segment{ CurrentSegment() };
+                const FloatType target{ CurrentTarget() }, end{ CurrentEnd() };
+                const size_t uStageLength{ SamplesUntil(segment, target, end) };
+                const size_t uCount{ std::min(uStageLength, uRemaining) };
+
+                if (pRun)
+                    ApplySegment(segment, target, pRun, uCount);
+                else
+                    m_Level = target + (m_Level - target) *
+                              std::pow(segment.coefficient, (FloatType)uCount);
+                uDone += uCount;
+
+                if (uCount == uStageLength)
+                {
+                    m_Level = end;
+                    NextStage();
+                }
+            }
+        }
+
+        // -------------------------------------------------------------------------------
+        // Calculates the coefficient for a segment lasting _seconds, where _ratio sets
+        // how far the overshoot target is beyond the end level. Small ratios give more
+        // strongly exponential curves.
+        // -------------------------------------------------------------------------------
+        Segment MakeSegment(FloatType _seconds, FloatType _ratio) const
+        {
+            Segment segment;
+            segment.ratio = _ratio;
+
+            const FloatType samples{ _seconds * m_SampleRate };
+            if (samples > 0.0)
+                segment.coefficient = std::exp(-std::log((1 + _ratio) / _ratio) / samples);
+
+            segment.vPowers[0] = 1.0;
+            for (size_t i{ 1 }; i <= LANES; ++i)
+                segment.vPowers[i] = segment.vPowers[i - 1] * segment.coefficient;
+
+            return segment;
+        }
+
+        const Segment& CurrentSegment() const
+        {
+            if (m_Stage == Stage::Attack) return m_Attack;
+            if (m_Stage == Stage::Decay) return m_Decay;
+            return m_Release;
+        }
+
+        // -------------------------------------------------------------------------------
+        // Returns the overshoot target the current stage approaches.
+        // -------------------------------------------------------------------------------
+        FloatType CurrentTarget() const
+        {
+            if (m_Stage == Stage::Attack) return 1 + m_Attack.ratio;
+            if (m_Stage == Stage::Decay) return m_Sustain - m_Decay.ratio;
+            return -m_Release.ratio;
+        }
+
+        // -------------------------------------------------------------------------------
+        // Returns the level at which the current stage ends.
+        // -------------------------------------------------------------------------------
+        FloatType CurrentEnd() const
+        {
+            if (m_Stage == Stage::Attack) return 1.0;
+            if (m_Stage == Stage::Decay) return m_Sustain;
+            return 0.0;
+        }
+
+        void NextStage()
+        {
+            if (m_Stage == Stage::Attack) m_Stage = Stage::Decay;
+            else if (m_Stage == Stage::Decay) m_Stage = Stage::Sustain;
+            else if (m_Stage == Stage::Release) m_Stage = Stage::Idle;
+        }
+
+        // -------------------------------------------------------------------------------
+        // Calculates how many samples the recurrence takes to pass _end from m_Level.
+        // The release ends at IDLE_LEVEL rather than at exactly 0.
+        // -------------------------------------------------------------------------------
+        size_t SamplesUntil(const Segment& _segment, FloatType _target, FloatType _end) const
+        {
+            if (m_Stage == Stage::Release)
+                _end = IDLE_LEVEL;
+
+            const FloatType fraction{ (_end - _target) / (m_Level - _target) };
+            if (_segment.coefficient <= 0.0 || fraction <= 0.0 || fraction >= 1.0)
+                return 0;
+
+            return (size_t)std::ceil(std::log(fraction) / std::log(_segment.coefficient));
+        }
+
+        // -------------------------------------------------------------------------------
+        // Multiplies _uCount samples by the segment's levels, LANES at a time.
+        // -------------------------------------------------------------------------------
+        void ApplySegment(const Segment& _segment,
+                          FloatType _target,
+                          FloatType* _pBuffer,
+                          size_t _uCount)
+        {
+            FloatType offset{ m_Level - _target };
+            size_t i{ 0 };
+            for (; i + LANES <= _uCount; i += LANES)
+            {
+                for (size_t l{ 0 }; l < LANES; ++l)
+                    _pBuffer[i + l] *= _target + offset * _segment.vPowers[l];
+                offset *= _segment.vPowers[LANES];
+            }
+
+            for (size_t l{ 0 }; i < _uCount; ++i, ++l)
+                _pBuffer[i] *= _target + offset * _segment.vPowers[l];
+            offset *= _segment.vPowers[_uCount % LANES];
+
+            m_Level = _target + offset;
+        }
+
+    private:
+        const FloatType m_SampleRate;
+        FloatType m_Sustain;
+        Segment m_Attack;
+        Segment m_Decay;
+        Segment m_Release;
+
+        Stage m_Stage = Stage::Idle;
+        FloatType m_Level = 0.0;
+    };
+
+    // -----------------------------------------------------------------------------------
+    // Voice class. Pairs an oscillator with an Envelope. While the envelope is idle the
+    // oscillator is not rendered at all, so sleeping voices cost almost nothing.
+    //
+    // WaveType can be any class with a BlockState NextBlock(FloatType*, size_t) method,
+    // such as SineWave, SquareWave or AdditiveRenderer.
+    // -----------------------------------------------------------------------------------
+    template<typename FloatType, typename WaveType>
+    class Voice
+    {
+    public:
+        Voice() = delete;
+
+        Voice(const WaveType& _wave, const Envelope<FloatType>& _envelope) :
+            m_Wave(_wave),
+            m_Envelope(_envelope) {};
+
+    public:
+        void NoteOn() { m_Envelope.NoteOn(); };
+        void NoteOff() { m_Envelope.NoteOff(); };
+        bool IsIdle() const { return m_Envelope.IsIdle(); };
+
+        WaveType& GetWave() { return m_Wave; };
+        Envelope<FloatType>& GetEnvelope() { return m_Envelope; };
+
+        // -------------------------------------------------------------------------------
+        // Writes the next _uNumSamples samples of the enveloped oscillator into
+        // _pOutput. If the voice is idle the output is zeroed and the oscillator is not
+        // run.
+        //
+        // Arguments:
+        //     _pOutput     - buffer of at least _uNumSamples values
+        //     _uNumSamples - number of samples to render
+        //
+        // Returns:
+        //     state of the rendered block, Silent if the voice was idle
+        // -------------------------------------------------------------------------------
+        BlockState NextBlock(FloatType* _pOutput, size_t _uNumSamples)
+        {
+            if (m_Envelope.IsIdle())
+            {
+                std::fill(_pOutput, _pOutput + _uNumSamples, (FloatType)0.0);
+                return BlockState::Silent;
+            }
+
+            const BlockState state{ m_Wave.NextBlock(_pOutput, _uNumSamples) };
+            return m_Envelope.ProcessBlock(_pOutput, _uNumSamples, state);
+        }
+
+    private:
+        WaveType m_Wave;
+        Envelope<FloatType> m_Envelope;
+    };
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "AdditiveFFT.h"
+#include "Block.h"
+#include "CycleCache.h"
+#include "Envelope.h"
+#include "Oscillator.h"
+
+namespace osc
+{
+    // -----------------------------------------------------------------------------------
+    // Parameter changes that can be scheduled inside a block.
+    // -----------------------------------------------------------------------------------
+    enum class EventType
+    {
+        Frequency,
+        Amplitude,
+        NumHarmonics,
+        NoteOn,
+        NoteOff
+    };
+
+    // -----------------------------------------------------------------------------------
+    // A parameter change taking effect at sample uOffset of a block. value is unused by
+    // NoteOn and NoteOff.
+    // -----------------------------------------------------------------------------------
+    struct Event
+    {
+        size_t uOffset = 0;
+        EventType type = EventType::Frequency;
+        double value = 0.0;
+    };
+
+    // -----------------------------------------------------------------------------------
+    // EventList class. The events for one block, kept sorted by offset. Events with the
+    // same offset are applied in the order they were added.
+    // -----------------------------------------------------------------------------------
+    class EventList
+    {
+    public:
+        // -------------------------------------------------------------------------------
+        // Schedules an event.
+        //
+        // Arguments:
+        //     _uOffset - sample in the block at which the event takes effect
+        //     _type    - parameter to change
+        //     _value   - new value of the parameter
+        //
+        // Returns:
+        //     void
+        // -------------------------------------------------------------------------------
+        void Add(size_t _uOffset, EventType _type, double _value = 0.0)
+        {
+            auto it{ std::upper_bound(m_vEvents.begin(), m_vEvents.end(), _uOffset,
+                                      [](size_t _uValue, const Event& _event) {
+                                          return _uValue < _event.uOffset;
+                                      }) };
+            m_vEvents.insert(it, { _uOffset, _type, _value });
+        }
+
+        void Clear() { m_vEvents.clear(); };
+        bool Empty() const { return m_vEvents.empty(); };
+        size_t Size() const { return m_vEvents.size(); };
+
+        std::vector<Event>::const_iterator begin() const { return m_vEvents.begin(); };
+        std::vector<Event>::const_iterator end() const { return m_vEvents.end(); };
+
+    private:
+        std::vector<Event> m_vEvents;
+    };
+
+    // -----------------------------------------------------------------------------------
+    // Applies an event to a wave or voice. Events a target does not have a parameter for
+    // are ignored. Targets without an overload here do not compile.
+    // -----------------------------------------------------------------------------------
+    template<typename FloatType, typename PhaseType>
+    void ApplyEvent(SineWave<FloatType, PhaseType>& _sine, const Event& _event)
+    {
+        if (_event.type == EventType::Frequency)
+            _sine.SetFrequency((FloatType)_event.value);
+        else if (_event.type == EventType::Amplitude)
+            _sine.SetAmplitude((FloatType)_event.value);
+    }
+
+    template<typename FloatType, typename PhaseType>
+    void ApplyEvent(ComplexWave<FloatType, PhaseType>& _wave, const Event& _event)
+    {
+        if (_event.type == EventType::Frequency)
+            _wave.SetFrequency((FloatType)_event.value);
+        else if (_event.type == EventType::Amplitude)
+            _wave.SetAmplitude((FloatType)_event.value);
+        else if (_event.type == EventType::NumHarmonics)
+            _wave.SetNumHarmonics((size_t)std::max(_event.value, 0.0));
+    }
+
+    template<typename FloatType, typename PhaseType>
+    void ApplyEvent(AdditiveRenderer<FloatType, PhaseType>& _renderer, const Event& _event)
+    {
+        if (_event.type == EventType::NoteOn || _event.type == EventType::NoteOff)
+            return;
+
+        ApplyEvent(_renderer.GetWave(), _event);
+        _renderer.Update();
+    }
+
+    template<typename FloatType, typename WaveType>
+    void ApplyEvent(CachedWave<FloatType, WaveType>& _cached, const Event& _event)
+    {
+        ApplyEvent(_cached.GetWave(), _event);
+    }
+
+    template<typename FloatType, typename WaveType>
+    void ApplyEvent(Voice<FloatType, WaveType>& _voice, const Event& _event)
+    {
+        if (_event.type == EventType::NoteOn)
+            _voice.NoteOn();
+        else if (_event.type == EventType::NoteOff)
+            _voice.NoteOff();
+        else
+            ApplyEvent(_voice.GetWave(), _event);
+    }
+
+    // -----------------------------------------------------------------------------------
+    // Renders a block with sample-accurate parameter changes. The block is split into
+    // runs at the event offsets, and each run is rendered with NextBlock(), so the fast
+    // block paths are kept between events. Events at the end of the block are applied
+    // after the last run. Events beyond it are not applied, but carried into _carried
+    // with their offsets made relative to the next block, so they can be rendered with
+    // it.
+    //
+    // Arguments:
+    //     _target      - SineWave, ComplexWave, AdditiveRenderer, CachedWave or Voice to
+    //                    render
+    //     _pOutput     - buffer of at least _uNumSamples values
+    //     _uNumSamples - number of samples to render
+    //     _events      - events for this block
+    //     _carried     - list the events for later blocks are added to. Must not be
+    //                    _events
+    //
+    // Returns:
+    //     state of the rendered block
+    // -----------------------------------------------------------------------------------
+    template<typename FloatType, typename TargetType>
+    BlockState RenderBlock(TargetType& _target,
+                           FloatType* _pOutput,
+                           size_t _uNumSamples,
+                           const EventList& _events,
+                           EventList& _carried)
+    {
+        BlockState state{ BlockState::Silent };
+        bool bFirstRun{ true };
+        size_t uStart{ 0 };
+
+        auto render = [&](size_t _uEnd) {
+            if (_uEnd <= uStart)
+                return;
+
+            const BlockState runState{ _target.NextBlock(_pOutput + uStart, _uEnd - uStart) };
+            state = bFirstRun ? runState : AppendStates(state, runState);
+            bFirstRun = false;
+            uStart = _uEnd;
+        };
+
+        for (auto& event : _events)
+        {
+            if (event.uOffset > _uNumSamples)
+            {
+                _carried.Add(event.uOffset - _uNumSamples, event.type, event.value);
+                continue;
+            }
+
+            render(event.uOffset);
+            ApplyEvent(_target, event);
+        }
+        render(_uNumSamples);
+
+        return state;
+    }
+}
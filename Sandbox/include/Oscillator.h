@@ -3,24 +3,75 @@
 
 #include <vector>
 #include <utility>
+#include <algorithm>
+#include <cmath>
+
+#include "Block.h"
 
 #define M_PI 3.14159265358979323846
 
 namespace osc
 {
+    // -----------------------------------------------------------------------------------
+    // Number of samples processed at a time by the block rendering methods. Phase is
+    // re-anchored from the accumulated phase at the start of every chunk, so per-sample
+    // phase offsets stay small enough to compute in FloatType. Sample indices within a
+    // chunk must fit in 8 bits for the exact offsets used by SineWave::AddBlock().
+    // -----------------------------------------------------------------------------------
+    constexpr size_t BLOCK_CHUNK_SIZE = 256;
+
+    // -----------------------------------------------------------------------------------
+    // Polynomial approximation of sin() for single precision block rendering. Written
+    // without branches or calls so the loops using it can be vectorised (8 lanes wide
+    // with AVX). Maximum error is around 1e-7 over the input range.
+    //
+    // Arguments:
+    //     _x - angle in the range [0, 2 * pi)
+    //
+    // Returns:
+    //     approximation of sin(_x)
+    // -----------------------------------------------------------------------------------
+    inline float FastSin(float _x)
+    {
+        constexpr float PI = (float)M_PI;
+        constexpr float HALF_PI = (float)(M_PI / 2.0);
+
+        // sin(x) = -sin(x - pi), then fold into [-pi / 2, pi / 2].
+        float y{ _x - PI };
+        y = std::copysign(HALF_PI - std::fabs(std::fabs(y) - HALF_PI), y);
+
+        const float y2{ y * y };
+        float p{ -2.50521084e-8f };
+        p = p * y2 + 2.75573192e-6f;
+        p = p * y2 - 1.98412698e-4f;
+        p = p * y2 + 8.33333333e-3f;
+        p = p * y2 - 1.66666667e-1f;
+        p = p * y2 + 1.0f;
+
+        return -(y * p);
+    }
+
     // -----------------------------------------------------------------------------------
     // SineWave class. Can be used to produce a sine wave in terms of samples ranging
-    // between -1.0 and 1.0. Samples are produced individually by NextSample() method.
+    // between -1.0 and 1.0. Samples are produced individually by NextSample() method,
+    // or in blocks by AddBlock()/NextBlock().
     // The sample rate is const so cannot be changed once the SineWave object is
     // instantiated.
+    //
+    // PhaseType is the precision the phase is accumulated in. SineWave<float, double>
+    // is the mixed-precision mode: phase is kept in double so pitch does not drift over
+    // long runs, while samples are evaluated and summed in float.
     // -----------------------------------------------------------------------------------
-    template<typename FloatType>
+    template<typename FloatType, typename PhaseType = FloatType>
     class SineWave
     {
     public:
         static_assert(std::is_same_v<float, FloatType>
                       || std::is_same_v<double, FloatType>,
             "SineWave class template argument must be of type float or double");
+        static_assert(std::is_same_v<float, PhaseType>
+                      || std::is_same_v<double, PhaseType>,
+            "SineWave phase type must be float or double");
         
     public:
         SineWave() = delete;
@@ -59,7 +110,7 @@ namespace osc
         void SetFrequency(const FloatType _frequency)
         {
             m_Frequency = _frequency;
-            m_PhaseDiff = TWO_PI * m_Frequency / m_SampleRate;
+            m_PhaseDiff = TWO_PI * (PhaseType)m_Frequency / (PhaseType)m_SampleRate;
         };
         FloatType GetFrequency() const { return m_Frequency; };
 
@@ -69,13 +120,15 @@ namespace osc
         };
 
         void SetAmplitude(const FloatType _amplitude) { m_Amplitude = _amplitude; };
-        FloatType GetAmplitude() { return m_Amplitude; };
+        FloatType GetAmplitude() const { return m_Amplitude; };
         FloatType GetSampleRate() const { return m_SampleRate; };
+        PhaseType GetPhase() const { return m_Phase; };
 
         // -------------------------------------------------------------------------------
         // Calculates the next sample value. The sample is 'muted' if m_Frequency is above
-        // the nyquist limit. m_Phase is always incremented by m_PhaseDiff and wrapped
-        // around 2 * pi. This ensures the oscillators stay in relative phase.
+        // the nyquist limit, and sin() is skipped if m_Amplitude is 0. m_Phase is always
+        // incremented by m_PhaseDiff and wrapped around 2 * pi. This ensures the
+        // oscillators stay in relative phase.
         //
         // Returns:
         //     the next sample value
@@ -83,7 +136,7 @@ namespace osc
         FloatType NextSample()
         {
             double dSample{ 0 };
-            if (m_Frequency < m_SampleRate / 2.0)
+            if (!IsSilent())
                 dSample = m_Amplitude * sin(m_Phase);
 
             m_Phase += m_PhaseDiff;
@@ -94,19 +147,163 @@ namespace osc
             return dSample;
         }
 
+        // -------------------------------------------------------------------------------
+        // Adds the next _uNumSamples sample values to the values already in _pOutput.
+        // This produces the same wave as NextSample(), but the phase of each sample is
+        // calculated from the phase at the start of its chunk rather than accumulated,
+        // and single precision output uses FastSin(). Results are therefore close to,
+        // but not bit-for-bit equal to, NextSample().
+        // For single precision output only the chunk anchor is taken from m_Phase; the
+        // per-sample offsets and wrapping are done in float, so SineWave<float, double>
+        // runs as many lanes wide as SineWave<float>. Offsets are kept exact by splitting
+        // m_PhaseDiff and 2 * pi into high and low parts (Cody-Waite reduction).
+        // Silent waves only advance m_Phase, and a wave with a frequency of 0 adds the
+        // same value to every sample.
+        //
+        // Arguments:
+        //     _pOutput     - buffer of at least _uNumSamples values to add to
+        //     _uNumSamples - number of samples to render
+        //
+        // Returns:
+        //     state of the samples added
+        // -------------------------------------------------------------------------------
+        BlockState AddBlock(FloatType* _pOutput, size_t _uNumSamples)
+        {
+            if (IsSilent())
+            {
+                AdvancePhase(_uNumSamples);
+                return BlockState::Silent;
+            }
+
+            if (m_PhaseDiff == 0.0)
+            {
+                const FloatType value{ m_Amplitude * (FloatType)sin(m_Phase) };
+                if (value == 0.0)
+                    return BlockState::Silent;
+
+                for (size_t i{ 0 }; i < _uNumSamples; ++i)
+                    _pOutput[i] += value;
+                return BlockState::Constant;
+            }
+
+            float diffHigh{ 0.0f }, diffLow{ 0.0f };
+            if constexpr (std::is_same_v<float, FloatType>)
+                SplitPhaseDiff(diffHigh, diffLow);
+
+            for (size_t uStart{ 0 }; uStart < _uNumSamples; uStart += BLOCK_CHUNK_SIZE)
+            {
+                const size_t uCount{ std::min(BLOCK_CHUNK_SIZE, _uNumSamples - uStart) };
+                FloatType* pChunk{ _pOutput + uStart };
+                const FloatType amplitude{ m_Amplitude };
+
+                // int indices so the conversions vectorise.
+                if constexpr (std::is_same_v<float, FloatType>)
+                {
+                    const float anchor{ (float)m_Phase };
+                    for (int i{ 0 }; i < (int)uCount; ++i)
+                    {
+                        // offset and k * TWO_PI_HIGH are exact, so their difference is
+                        // too, and only small values are rounded afterwards.
+                        const float offset{ (float)i * diffHigh };
+                        const float k{ (float)(int)((anchor + offset) * INV_TWO_PI_FLOAT) };
+                        float p{ offset - k * TWO_PI_HIGH };
+                        p = (p - k * TWO_PI_LOW) + (anchor + (float)i * diffLow);
+
+                        pChunk[i] += amplitude * FastSin(p);
+                    }
+                }
+                else
+                {
+                    const PhaseType phase{ m_Phase }, phaseDiff{ m_PhaseDiff };
+                    for (int i{ 0 }; i < (int)uCount; ++i)
+                    {
+                        PhaseType p{ phase + (PhaseType)i * phaseDiff };
+                        p -= TWO_PI * (PhaseType)(int)(p * INV_TWO_PI);
+
+                        pChunk[i] += amplitude * (FloatType)sin(p);
+                    }
+                }
+
+                AdvancePhase(uCount);
+            }
+
+            return BlockState::Signal;
+        }
+
+        // -------------------------------------------------------------------------------
+        // Writes the next _uNumSamples sample values into _pOutput.
+        //
+        // Arguments:
+        //     _pOutput     - buffer of at least _uNumSamples values
+        //     _uNumSamples - number of samples to render
+        //
+        // Returns:
+        //     state of the rendered block
+        // -------------------------------------------------------------------------------
+        BlockState NextBlock(FloatType* _pOutput, size_t _uNumSamples)
+        {
+            std::fill(_pOutput, _pOutput + _uNumSamples, (FloatType)0.0);
+            return AddBlock(_pOutput, _uNumSamples);
+        }
+
+        // -------------------------------------------------------------------------------
+        // Returns true if the wave produces no output, either because m_Amplitude is 0
+        // or because m_Frequency is above the nyquist limit.
+        // -------------------------------------------------------------------------------
+        bool IsSilent() const
+        {
+            return m_Amplitude == 0.0 || m_Frequency >= m_SampleRate / 2.0;
+        }
+
+        // -------------------------------------------------------------------------------
+        // Moves m_Phase forward by _uNumSamples samples without producing any output.
+        //
+        // Arguments:
+        //     _uNumSamples - number of samples to skip
+        //
+        // Returns:
+        //     void
+        // -------------------------------------------------------------------------------
+        void AdvancePhase(size_t _uNumSamples)
+        {
+            m_Phase += (PhaseType)_uNumSamples * m_PhaseDiff;
+            m_Phase -= TWO_PI * std::floor(m_Phase * INV_TWO_PI);
+        }
+
+    private:
+        // -------------------------------------------------------------------------------
+        // Splits m_PhaseDiff into a high part with 16 significant bits, so multiplying it
+        // by a chunk index of at most 8 bits is exact in float, and the float remainder.
+        // -------------------------------------------------------------------------------
+        void SplitPhaseDiff(float& _high, float& _low) const
+        {
+            static_assert(BLOCK_CHUNK_SIZE <= 256, "Chunk indices must fit in 8 bits");
+
+            int exponent{ 0 };
+            const double mantissa{ std::frexp((double)m_PhaseDiff, &exponent) };
+            _high = (float)std::ldexp(std::trunc(std::ldexp(mantissa, 16)), exponent - 16);
+            _low = (float)((double)m_PhaseDiff - (double)_high);
+        }
+
     private:
         const FloatType m_SampleRate;
         FloatType m_Amplitude;
         FloatType m_Frequency;
 
-        FloatType m_Phase = 0.0;
-        FloatType m_PhaseDiff = 0.0;
+        PhaseType m_Phase = 0.0;
+        PhaseType m_PhaseDiff = 0.0;
 
     private:
-        static constexpr FloatType TWO_PI = 2 * M_PI;
+        static constexpr PhaseType TWO_PI = 2 * M_PI;
+        static constexpr PhaseType INV_TWO_PI = 1.0 / (2 * M_PI);
+
+        // 2 * pi to 16 significant bits, so multiples by up to 8 bit integers are exact.
+        static constexpr float TWO_PI_HIGH = 6.2830810546875f;
+        static constexpr float TWO_PI_LOW = (float)(2 * M_PI - 6.2830810546875);
+        static constexpr float INV_TWO_PI_FLOAT = (float)(1.0 / (2 * M_PI));
     };
 
-    template<typename FloatType>
+    template<typename FloatType, typename PhaseType = FloatType>
     class ComplexWave
     {
     public:
@@ -141,6 +338,7 @@ namespace osc
         FloatType GetFrequency() const { return m_vSines.front().GetFrequency(); };
         void MultiplyFrequency(const FloatType _multipler)
         {
+            m_Frequency *= _multipler;
             for (auto& s : m_vSines)
                 s.MultiplyFrequency(_multipler);
         }
@@ -161,6 +359,44 @@ namespace osc
             return sample;
         }
 
+        // -------------------------------------------------------------------------------
+        // Writes the sum of the SineWaves inside m_vSines into _pOutput. The output is
+        // rendered in chunks of BLOCK_CHUNK_SIZE so the buffer stays in cache while each
+        // SineWave adds to it. Silent SineWaves, such as harmonics above the nyquist
+        // limit, have their phase advanced once for the whole block and are left out of
+        // the chunk loop.
+        //
+        // Arguments:
+        //     _pOutput     - buffer of at least _uNumSamples values
+        //     _uNumSamples - number of samples to render
+        //
+        // Returns:
+        //     state of the rendered block
+        // -------------------------------------------------------------------------------
+        BlockState NextBlock(FloatType* _pOutput, size_t _uNumSamples)
+        {
+            std::fill(_pOutput, _pOutput + _uNumSamples, (FloatType)0.0);
+
+            m_vAudible.clear();
+            for (auto& s : m_vSines)
+            {
+                if (s.IsSilent())
+                    s.AdvancePhase(_uNumSamples);
+                else
+                    m_vAudible.push_back(&s);
+            }
+
+            BlockState state{ BlockState::Silent };
+            for (size_t uStart{ 0 }; uStart < _uNumSamples; uStart += BLOCK_CHUNK_SIZE)
+            {
+                const size_t uCount{ std::min(BLOCK_CHUNK_SIZE, _uNumSamples - uStart) };
+                for (auto pSine : m_vAudible)
+                    state = CombineStates(state, pSine->AddBlock(_pOutput + uStart, uCount));
+            }
+
+            return state;
+        }
+
         // -------------------------------------------------------------------------------
         // Sets the number of harmonics produced. If this is larger than the previous
         // number then the new SineWave objects have the correct amplitude and frequency
@@ -182,6 +418,42 @@ namespace osc
         size_t GetNumHarmonics() const { return m_vSines.size() - 1; };
         FloatType GetAmplitude() const { return m_Amplitude; };
         FloatType GetSampleRate() const { return m_SampleRate; };
+        const std::vector<SineWave<FloatType, PhaseType>>& GetSines() const
+        {
+            return m_vSines;
+        };
+
+        // -------------------------------------------------------------------------------
+        // Moves the phase of every SineWave forward by _uNumSamples samples without
+        // producing any output. Used when the wave is rendered by another engine, so
+        // switching back to NextSample() or NextBlock() continues in phase.
+        //
+        // Arguments:
+        //     _uNumSamples - number of samples to skip
+        //
+        // Returns:
+        //     void
+        // -------------------------------------------------------------------------------
+        void AdvancePhase(size_t _uNumSamples)
+        {
+            for (auto& s : m_vSines)
+                s.AdvancePhase(_uNumSamples);
+        }
+
+        // -------------------------------------------------------------------------------
+        // Sets the overall amplitude and lets the derived wave rescale its harmonics.
+        //
+        // Arguments:
+        //     _amplitude - new amplitude of the complex wave
+        //
+        // Returns:
+        //     void
+        // -------------------------------------------------------------------------------
+        void SetAmplitude(const FloatType _amplitude)
+        {
+            m_Amplitude = _amplitude;
+            SetAmplitude();
+        }
 
         virtual void SetAmplitude() = 0;
 
@@ -189,11 +461,15 @@ namespace osc
         const FloatType m_SampleRate;
         FloatType m_Frequency;
         FloatType m_Amplitude;
-        std::vector<SineWave<FloatType>> m_vSines;
+        std::vector<SineWave<FloatType, PhaseType>> m_vSines;
+
+    private:
+        // Scratch list of the SineWaves audible in the current block.
+        std::vector<SineWave<FloatType, PhaseType>*> m_vAudible;
     };
 
-    template<typename FloatType>
-    class SquareWave : public ComplexWave<FloatType>
+    template<typename FloatType, typename PhaseType = FloatType>
+    class SquareWave : public ComplexWave<FloatType, PhaseType>
     {
     public:
         static_assert(std::is_same_v<float, FloatType>
@@ -217,10 +493,10 @@ namespace osc
                    FloatType _frequency = 0.0,
                    FloatType _amplitude = 1.0,
                    size_t _uNumHarmonics = 10) :
-            ComplexWave<FloatType>(_sampleRate,
-                                   _frequency,
-                                   _amplitude,
-                                   _uNumHarmonics)
+            ComplexWave<FloatType, PhaseType>(_sampleRate,
+                                              _frequency,
+                                              _amplitude,
+                                              _uNumHarmonics)
         {
             SetNumHarmonics(_uNumHarmonics);
         };
@@ -239,6 +515,7 @@ namespace osc
         // -------------------------------------------------------------------------------
         void SetFrequency(const FloatType _frequency) override
         {
+            this->m_Frequency = _frequency;
             if (this->m_vSines.empty()) return;
 
             this->m_vSines.front().SetFrequency(_frequency);
@@ -252,6 +529,7 @@ namespace osc
             }
         }
 
+        using ComplexWave<FloatType, PhaseType>::SetAmplitude;
         void SetAmplitude() override
         {
             for (FloatType i{ 0 }; i < this->m_vSines.size(); ++i)
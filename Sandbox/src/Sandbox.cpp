@@ -3,6 +3,7 @@
 #include <iostream>
 
 #include "olcNoiseMaker.h"
+#include "BatchRenderer.h"
 #include "Oscillator.h"
 
 double dSampleRate = 44100.0;
@@ -32,8 +33,45 @@ void PrintWave(size_t _length)
     }
 }
 
-int main()
+// ---------------------------------------------------------------------------------------
+// Renders every job in a manifest file and prints the throughput of each.
+// ---------------------------------------------------------------------------------------
+int RunBatch(const char* _manifestPath)
 {
+    std::ifstream manifest(_manifestPath);
+    if (!manifest.is_open())
+    {
+        std::cout << "Failed to open manifest\n";
+        return 1;
+    }
+
+    std::vector<osc::RenderJob> vJobs;
+    std::string error;
+    if (!osc::ParseManifest(manifest, vJobs, error))
+    {
+        std::cout << "Invalid manifest, " << error << "\n";
+        return 1;
+    }
+
+    osc::BatchRenderer<float> renderer;
+    bool bSucceeded{ true };
+    for (auto& report : renderer.Run(vJobs))
+    {
+        std::cout << report.name << ": " << report.uNumSamples << " samples in "
+                  << report.seconds << " s, " << report.samplesPerSecond << " samples/s"
+                  << (report.bReused ? " (reused)" : "")
+                  << (report.bSucceeded ? "" : " FAILED") << "\n";
+        bSucceeded &= report.bSucceeded;
+    }
+
+    return bSucceeded ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+        return RunBatch(argv[1]);
+
     auto devs{ olcNoiseMaker<short>::Enumerate() };
     olcNoiseMaker<short> nm(devs[0]);
 
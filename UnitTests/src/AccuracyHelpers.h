@@ -0,0 +1,421 @@
+#pragma once
+
+#define NUM_SAMPLES_ACCURACY_TEST 2097152
+#define NUM_SAMPLES_COMPLEX_ACCURACY_TEST 1048576
+#define NUM_SAMPLES_THD_WINDOW 65536
+#define MAX_THD_HARMONIC 10
+#define ACCURACY_TEST_BLOCK_SIZE 500
+#define NUM_SAMPLES_FFT_ACCURACY_TEST 131072
+#define FFT_TEST_NUM_HARMONICS 63
+
+// ---------------------------------------------------------------------------------------
+// Instruction vectors for the accuracy tests. Amplitude is fixed at full scale so SNR
+// and THD are meaningful.
+// ---------------------------------------------------------------------------------------
+std::vector<FLOAT_T> vAccuracyFrequencies{ 10.0, 1000.0 };
+
+// ---------------------------------------------------------------------------------------
+// Kernels that produce oscillator output. Each mode has its own accuracy thresholds, so
+// faster kernels can be tested against the reference without requiring bit-for-bit
+// equality.
+// ---------------------------------------------------------------------------------------
+enum class KernelMode
+{
+    Reference,      // NextSample() using sin() per partial
+    Block,          // NextBlock() with phase in FloatType
+    MixedPrecision, // NextBlock() with float samples and double phase
+    FFT             // FFTAdditiveEngine overlap-add synthesis
+};
+
+// ---------------------------------------------------------------------------------------
+// Limits a kernel must stay within over a long run. Errors are absolute, ULPs are
+// measured relative to the full-scale amplitude of the wave, SNR and THD are in dB and
+// phase drift is in radians.
+// ---------------------------------------------------------------------------------------
+struct AccuracyThresholds
+{
+    double maxAbsError;
+    double maxUlpError;
+    double minSnrDb;
+    double maxThdDb;
+    double maxPhaseDrift;
+};
+
+// ---------------------------------------------------------------------------------------
+// maxUlpError for lossy kernels, whose error is set by the algorithm rather than by
+// rounding. Disables the ULP check.
+// ---------------------------------------------------------------------------------------
+constexpr double NO_ULP_LIMIT{ std::numeric_limits<double>::infinity() };
+
+// ---------------------------------------------------------------------------------------
+// Results of comparing an oscillator against the high-precision reference.
+// ---------------------------------------------------------------------------------------
+struct AccuracyStats
+{
+    double maxAbsError = 0.0;
+    double maxUlpError = 0.0;
+    double snrDb = std::numeric_limits<double>::infinity();
+    double thdDb = -std::numeric_limits<double>::infinity();
+    double maxPhaseDrift = 0.0;
+};
+
+// ---------------------------------------------------------------------------------------
+// Returns the accuracy thresholds for a kernel mode at a given precision.
+//
+// Arguments:
+//     _mode - kernel used to produce the samples under test
+//
+// Returns:
+//     thresholds the kernel must meet
+// ---------------------------------------------------------------------------------------
+template<typename FloatType>
+AccuracyThresholds GetThresholds(KernelMode _mode)
+{
+    if constexpr (std::is_same_v<float, FloatType>)
+    {
+        switch (_mode)
+        {
+        case KernelMode::FFT:
+            return { 5e-4, NO_ULP_LIMIT, 70.0, -90.0, 1e-9 };
+        case KernelMode::MixedPrecision:
+            return { 2e-6, 20.0, 125.0, -130.0, 1e-9 };
+        case KernelMode::Block:
+            return { 2e-2, 2e5, 40.0, -100.0, 2e-2 };
+        case KernelMode::Reference:
+        default:
+            // Float phase accumulation drifts by up to 0.161 rad over the run, giving a
+            // worst measured SNR of 20.7 dB. The limits allow about 10% on top.
+            return { 1.8e-1, 1.5e6, 19.5, -28.5, 1.8e-1 };
+        }
+    }
+    else
+    {
+        switch (_mode)
+        {
+        case KernelMode::FFT:
+            return { 5e-4, NO_ULP_LIMIT, 70.0, -90.0, 1e-9 };
+        case KernelMode::Block:
+        case KernelMode::MixedPrecision:
+        case KernelMode::Reference:
+        default:
+            return { 1e-9, 5e6, 185.0, -190.0, 1e-9 };
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------
+// Calculates the exact phase of a tone at a given sample index. The phase is computed
+// directly from the index rather than accumulated, so it does not drift over long runs.
+// For whole number frequencies and sample rates, as used by every test, the position in
+// the cycle is found with exact integer arithmetic, so the only rounding is in the
+// final scaling to radians.
+//
+// Arguments:
+//     _frequency  - frequency of the tone in Hz
+//     _sampleRate - audio sample rate in Hz
+//     _uIndex     - sample index
+//
+// Returns:
+//     phase in the range [0, 2 * pi)
+// ---------------------------------------------------------------------------------------
+double ReferencePhase(double _frequency, double _sampleRate, size_t _uIndex)
+{
+    if (_frequency == std::floor(_frequency) && _sampleRate == std::floor(_sampleRate))
+    {
+        const unsigned long long uSampleRate{ (unsigned long long)_sampleRate };
+        const unsigned long long uRemainder{ (unsigned long long)_uIndex *
+                                             (unsigned long long)_frequency % uSampleRate };
+        return 2.0 * M_PI * (double)uRemainder / _sampleRate;
+    }
+
+    return 2.0 * M_PI * std::fmod((double)_uIndex * _frequency, _sampleRate) / _sampleRate;
+}
+
+// ---------------------------------------------------------------------------------------
+// Returns the reference sample for a set of tones. Tones at or above the nyquist limit
+// are muted, matching SineWave.
+//
+// Arguments:
+//     _vTones     - frequency and amplitude of each partial
+//     _sampleRate - audio sample rate in Hz
+//     _uIndex     - sample index
+//
+// Returns:
+//     sample value
+// ---------------------------------------------------------------------------------------
+double ReferenceSample(const std::vector<Tone<double>>& _vTones,
+                       double _sampleRate,
+                       size_t _uIndex)
+{
+    double sample{ 0.0 };
+    for (auto& t : _vTones)
+    {
+        if (t.frequency < _sampleRate / 2.0)
+            sample += t.amplitude * sin(ReferencePhase(t.frequency, _sampleRate, _uIndex));
+    }
+
+    return sample;
+}
+
+// ---------------------------------------------------------------------------------------
+// Wraps a phase difference to the range [-pi, pi].
+// ---------------------------------------------------------------------------------------
+double WrapPhase(double _phase)
+{
+    _phase = fmod(_phase, 2.0 * M_PI);
+    if (_phase > M_PI)
+        _phase -= 2.0 * M_PI;
+    else if (_phase < -M_PI)
+        _phase += 2.0 * M_PI;
+
+    return _phase;
+}
+
+// ---------------------------------------------------------------------------------------
+// Calculates the energy of a signal at a given frequency using a Hann windowed single
+// bin DFT.
+//
+// Arguments:
+//     _vSignal    - samples to analyse
+//     _frequency  - frequency of the bin in Hz
+//     _sampleRate - audio sample rate in Hz
+//
+// Returns:
+//     squared magnitude of the bin
+// ---------------------------------------------------------------------------------------
+double BinEnergy(const std::vector<double>& _vSignal, double _frequency, double _sampleRate)
+{
+    const size_t uSize{ _vSignal.size() };
+    double re{ 0.0 }, im{ 0.0 };
+    for (size_t i{ 0 }; i < uSize; ++i)
+    {
+        const double window{ 0.5 - 0.5 * cos(2.0 * M_PI * i / uSize) };
+        const double phase{ ReferencePhase(_frequency, _sampleRate, i) };
+        re += window * _vSignal[i] * cos(phase);
+        im += window * _vSignal[i] * sin(phase);
+    }
+
+    return re * re + im * im;
+}
+
+// ---------------------------------------------------------------------------------------
+// Runs an oscillator for a number of samples and compares each sample against the
+// reference. THD is measured over the last NUM_SAMPLES_THD_WINDOW samples by projecting
+// the error onto the harmonics of the fundamental.
+//
+// Arguments:
+//     _nextSample  - callable returning the next sample under test
+//     _phaseError  - callable taking the index of the sample just produced and returning
+//                    the oscillator phase error in radians
+//     _vTones      - partials of the reference, fundamental first
+//     _sampleRate  - audio sample rate in Hz
+//     _uNumSamples - number of samples to compare
+//
+// Returns:
+//     accuracy statistics for the run
+// ---------------------------------------------------------------------------------------
+template<typename FloatType, typename F, typename P>
+AccuracyStats MeasureAccuracy(F&& _nextSample,
+                              P&& _phaseError,
+                              const std::vector<Tone<double>>& _vTones,
+                              double _sampleRate,
+                              size_t _uNumSamples)
+{
+    AccuracyStats stats;
+
+    double fullScale{ 0.0 };
+    for (auto& t : _vTones)
+        fullScale += std::abs(t.amplitude);
+    const double ulp{ fullScale * std::numeric_limits<FloatType>::epsilon() };
+
+    const size_t uWindow{ std::min<size_t>(NUM_SAMPLES_THD_WINDOW, _uNumSamples) };
+    std::vector<double> vError, vReference;
+    vError.reserve(uWindow);
+    vReference.reserve(uWindow);
+
+    double signalEnergy{ 0.0 }, noiseEnergy{ 0.0 };
+    for (size_t i{ 0 }; i < _uNumSamples; ++i)
+    {
+        const double test{ (double)_nextSample() };
+        const double control{ ReferenceSample(_vTones, _sampleRate, i) };
+        const double error{ test - control };
+
+        stats.maxAbsError = std::max(stats.maxAbsError, std::abs(error));
+        if (ulp > 0.0)
+            stats.maxUlpError = std::max(stats.maxUlpError, std::abs(error) / ulp);
+        stats.maxPhaseDrift = std::max(stats.maxPhaseDrift, std::abs(_phaseError(i)));
+
+        signalEnergy += control * control;
+        noiseEnergy += error * error;
+
+        if (i >= _uNumSamples - uWindow)
+        {
+            vError.push_back(error);
+            vReference.push_back(control);
+        }
+    }
+
+    if (noiseEnergy > 0.0)
+        stats.snrDb = 10.0 * log10(signalEnergy / noiseEnergy);
+
+    // The window is analysed as if it started at index 0. Only bin magnitudes are used,
+    // so the offset does not matter.
+    const double fundamental{ _vTones.front().frequency };
+    const double fundamentalEnergy{ BinEnergy(vReference, fundamental, _sampleRate) };
+    double harmonicEnergy{ 0.0 };
+    for (size_t k{ 2 }; k <= MAX_THD_HARMONIC && k * fundamental < _sampleRate / 2.0; ++k)
+        harmonicEnergy += BinEnergy(vError, k * fundamental, _sampleRate);
+
+    if (harmonicEnergy > 0.0)
+        stats.thdDb = 10.0 * log10(harmonicEnergy / fundamentalEnergy);
+
+    return stats;
+}
+
+// ---------------------------------------------------------------------------------------
+// Hands out samples one at a time from an oscillator's NextBlock() method, so block
+// kernels can be measured by MeasureAccuracy().
+// ---------------------------------------------------------------------------------------
+template<typename FloatType, typename WaveType>
+struct BlockReader
+{
+    BlockReader(WaveType& _wave, size_t _uBlockSize) :
+        wave(_wave),
+        vBlock(_uBlockSize),
+        uPosition(_uBlockSize) {};
+
+    FloatType operator()()
+    {
+        if (uPosition == vBlock.size())
+        {
+            wave.NextBlock(vBlock.data(), vBlock.size());
+            uSamplesRendered += vBlock.size();
+            uPosition = 0;
+        }
+
+        return vBlock[uPosition++];
+    }
+
+    WaveType& wave;
+    std::vector<FloatType> vBlock;
+    size_t uPosition;
+    size_t uSamplesRendered = 0;
+};
+
+// ---------------------------------------------------------------------------------------
+// Measures a wave against the reference, including drift of its internal phase.
+//
+// Arguments:
+//     _wave        - wave to measure
+//     _getPhase    - callable returning the current phase of the wave's fundamental
+//     _vTones      - partials of the reference, fundamental first
+//     _sampleRate  - audio sample rate in Hz
+//     _uNumSamples - number of samples to compare
+//     _uBlockSize  - samples per NextBlock() call, or 0 to use NextSample()
+//
+// Returns:
+//     accuracy statistics for the run
+// ---------------------------------------------------------------------------------------
+template<typename FloatType, typename WaveType, typename G>
+AccuracyStats MeasureWave(WaveType& _wave,
+                          G&& _getPhase,
+                          const std::vector<Tone<double>>& _vTones,
+                          double _sampleRate,
+                          size_t _uNumSamples,
+                          size_t _uBlockSize)
+{
+    const double frequency{ _vTones.front().frequency };
+
+    if (_uBlockSize == 0)
+    {
+        return MeasureAccuracy<FloatType>(
+            [&]() { return _wave.NextSample(); },
+            [&](size_t i) {
+                return WrapPhase(_getPhase() - ReferencePhase(frequency, _sampleRate, i + 1));
+            },
+            _vTones, _sampleRate, _uNumSamples);
+    }
+
+    BlockReader<FloatType, WaveType> reader(_wave, _uBlockSize);
+    return MeasureAccuracy<FloatType>(
+        reader,
+        [&](size_t) {
+            return WrapPhase(_getPhase() -
+                             ReferencePhase(frequency, _sampleRate, reader.uSamplesRendered));
+        },
+        _vTones, _sampleRate, _uNumSamples);
+}
+
+// ---------------------------------------------------------------------------------------
+// Measures a SineWave against the reference. See MeasureWave().
+// ---------------------------------------------------------------------------------------
+template<typename FloatType, typename PhaseType>
+AccuracyStats MeasureSine(osc::SineWave<FloatType, PhaseType>& _sine,
+                          size_t _uNumSamples,
+                          size_t _uBlockSize = 0)
+{
+    std::vector<Tone<double>> vTones{ 1 };
+    vTones.front().frequency = _sine.GetFrequency();
+    vTones.front().amplitude = _sine.GetAmplitude();
+
+    return MeasureWave<FloatType>(_sine, [&]() { return _sine.GetPhase(); },
+                                  vTones, _sine.GetSampleRate(), _uNumSamples, _uBlockSize);
+}
+
+// ---------------------------------------------------------------------------------------
+// Measures a ComplexWave against reference partials, with phase drift measured on its
+// fundamental. See MeasureWave().
+// ---------------------------------------------------------------------------------------
+template<typename FloatType, typename PhaseType, typename WaveType>
+AccuracyStats MeasureComplex(WaveType& _wave,
+                             const std::vector<Tone<double>>& _vTones,
+                             size_t _uNumSamples,
+                             size_t _uBlockSize = 0)
+{
+    const osc::ComplexWave<FloatType, PhaseType>& wave{ _wave };
+    return MeasureWave<FloatType>(_wave,
+                                  [&]() { return wave.GetSines().front().GetPhase(); },
+                                  _vTones, wave.GetSampleRate(), _uNumSamples, _uBlockSize);
+}
+
+// ---------------------------------------------------------------------------------------
+// Builds the reference partials of a square wave: odd harmonics with amplitudes falling
+// off as 1 / n.
+//
+// Arguments:
+//     _frequency     - fundamental frequency in Hz
+//     _amplitude     - amplitude of the fundamental
+//     _uNumHarmonics - number of harmonics additional to the fundamental
+//
+// Returns:
+//     vector of reference partials
+// ---------------------------------------------------------------------------------------
+std::vector<Tone<double>> SquareReference(double _frequency,
+                                          double _amplitude,
+                                          size_t _uNumHarmonics)
+{
+    std::vector<Tone<double>> vTones{ _uNumHarmonics + 1 };
+    for (size_t i{ 0 }; i < vTones.size(); ++i)
+    {
+        vTones[i].frequency = _frequency * (2.0 * i + 1.0);
+        vTones[i].amplitude = _amplitude / (2.0 * i + 1.0);
+    }
+
+    return vTones;
+}
+
+// ---------------------------------------------------------------------------------------
+// Fails the current test if any statistic is outside its threshold.
+// ---------------------------------------------------------------------------------------
+void ExpectWithinThresholds(const AccuracyStats& _stats,
+                            const AccuracyThresholds& _thresholds)
+{
+    EXPECT_LE(_stats.maxAbsError, _thresholds.maxAbsError);
+    if (_thresholds.maxUlpError != NO_ULP_LIMIT)
+    {
+        EXPECT_LE(_stats.maxUlpError, _thresholds.maxUlpError);
+    }
+    EXPECT_GE(_stats.snrDb, _thresholds.minSnrDb);
+    EXPECT_LE(_stats.thdDb, _thresholds.maxThdDb);
+    EXPECT_LE(_stats.maxPhaseDrift, _thresholds.maxPhaseDrift);
+}
@@ -7,9 +7,21 @@
 
 #include "gtest/gtest.h"
 
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <limits>
 #include <string>
 #include <random>
 #include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
 #include <type_traits>
-#include "Oscillator.h"
\ No newline at end of file
+#include "Oscillator.h"
+#include "AdditiveFFT.h"
+#include "Envelope.h"
+#include "CycleCache.h"
+#include "Events.h"
+#include "BatchRenderer.h"
\ No newline at end of file
@@ -1,6 +1,7 @@
 
 #include "pch.h"
 #include "OscillatorHelpers.h"
+#include "AccuracyHelpers.h"
 
 // Tests SineWave against samples generated in CheckSine();
 TEST(SineTest, SampleTest)
@@ -25,3 +26,551 @@ TEST(SquareTest, SampleTest)
     for (auto& s : vSquares)
         CheckComplex(s, SquareInstructions);
 }
+
+// Tests SineWave accuracy over long runs against the high-precision reference.
+TEST(SineTest, AccuracyTest)
+{
+    for (auto& sr : vSampleRates)
+        for (auto& f : vAccuracyFrequencies)
+        {
+            osc::SineWave<double> sineDouble(sr, f, 1.0);
+            ExpectWithinThresholds(MeasureSine(sineDouble, NUM_SAMPLES_ACCURACY_TEST),
+                                   GetThresholds<double>(KernelMode::Reference));
+
+            osc::SineWave<float> sineFloat((float)sr, (float)f, 1.0f);
+            ExpectWithinThresholds(MeasureSine(sineFloat, NUM_SAMPLES_ACCURACY_TEST),
+                                   GetThresholds<float>(KernelMode::Reference));
+        }
+}
+
+// Tests SquareWave accuracy over long runs against the high-precision reference.
+TEST(SquareTest, AccuracyTest)
+{
+    const size_t uNumHarmonics{ vNumHarmonics.back() };
+    const FLOAT_T f{ vFrequencies.front() };
+    for (auto& sr : vSampleRates)
+    {
+        const auto vTones{ SquareReference(f, 1.0, uNumHarmonics) };
+
+        osc::SquareWave<double> squareDouble(sr, f, 1.0, uNumHarmonics);
+        ExpectWithinThresholds(
+            MeasureComplex<double, double>(squareDouble, vTones,
+                                           NUM_SAMPLES_COMPLEX_ACCURACY_TEST),
+            GetThresholds<double>(KernelMode::Reference));
+
+        osc::SquareWave<float> squareFloat((float)sr, (float)f, 1.0f, uNumHarmonics);
+        ExpectWithinThresholds(
+            MeasureComplex<float, float>(squareFloat, vTones,
+                                         NUM_SAMPLES_COMPLEX_ACCURACY_TEST),
+            GetThresholds<float>(KernelMode::Reference));
+    }
+}
+
+// Tests the SineWave block kernels, including the mixed-precision mode.
+TEST(SineTest, BlockAccuracyTest)
+{
+    for (auto& sr : vSampleRates)
+        for (auto& f : vAccuracyFrequencies)
+        {
+            osc::SineWave<double> sineDouble(sr, f, 1.0);
+            ExpectWithinThresholds(
+                MeasureSine(sineDouble, NUM_SAMPLES_ACCURACY_TEST, ACCURACY_TEST_BLOCK_SIZE),
+                GetThresholds<double>(KernelMode::Block));
+
+            osc::SineWave<float> sineFloat((float)sr, (float)f, 1.0f);
+            ExpectWithinThresholds(
+                MeasureSine(sineFloat, NUM_SAMPLES_ACCURACY_TEST, ACCURACY_TEST_BLOCK_SIZE),
+                GetThresholds<float>(KernelMode::Block));
+
+            osc::SineWave<float, double> sineMixed((float)sr, (float)f, 1.0f);
+            ExpectWithinThresholds(
+                MeasureSine(sineMixed, NUM_SAMPLES_ACCURACY_TEST, ACCURACY_TEST_BLOCK_SIZE),
+                GetThresholds<float>(KernelMode::MixedPrecision));
+        }
+}
+
+// Tests the SquareWave block kernels, including the mixed-precision mode.
+TEST(SquareTest, BlockAccuracyTest)
+{
+    const size_t uNumHarmonics{ vNumHarmonics.back() };
+    const FLOAT_T f{ vFrequencies.front() };
+    for (auto& sr : vSampleRates)
+    {
+        const auto vTones{ SquareReference(f, 1.0, uNumHarmonics) };
+
+        osc::SquareWave<double> squareDouble(sr, f, 1.0, uNumHarmonics);
+        ExpectWithinThresholds(
+            MeasureComplex<double, double>(squareDouble, vTones,
+                                           NUM_SAMPLES_COMPLEX_ACCURACY_TEST,
+                                           ACCURACY_TEST_BLOCK_SIZE),
+            GetThresholds<double>(KernelMode::Block));
+
+        osc::SquareWave<float, double> squareMixed((float)sr, (float)f, 1.0f, uNumHarmonics);
+        ExpectWithinThresholds(
+            MeasureComplex<float, double>(squareMixed, vTones,
+                                          NUM_SAMPLES_COMPLEX_ACCURACY_TEST,
+                                          ACCURACY_TEST_BLOCK_SIZE),
+            GetThresholds<float>(KernelMode::MixedPrecision));
+    }
+}
+
+// Tests FFTAdditiveEngine against the high-precision reference.
+TEST(AdditiveFFTTest, AccuracyTest)
+{
+    const FLOAT_T f{ 55.0 };
+    for (auto& sr : vSampleRates)
+    {
+        const auto vTones{ SquareReference(f, 0.5, FFT_TEST_NUM_HARMONICS) };
+
+        osc::SquareWave<float, double> squareFloat((float)sr, (float)f, 0.5f,
+                                                   FFT_TEST_NUM_HARMONICS);
+        osc::FFTAdditiveEngine<float> engineFloat((float)sr);
+        engineFloat.SetPartials(squareFloat);
+        BlockReader<float, osc::FFTAdditiveEngine<float>> readerFloat(engineFloat,
+                                                                      ACCURACY_TEST_BLOCK_SIZE);
+        ExpectWithinThresholds(
+            MeasureAccuracy<float>(
+                readerFloat,
+                [&](size_t) {
+                    return WrapPhase(engineFloat.GetPhase(0) -
+                                     ReferencePhase(f, sr, readerFloat.uSamplesRendered));
+                },
+                vTones, sr, NUM_SAMPLES_FFT_ACCURACY_TEST),
+            GetThresholds<float>(KernelMode::FFT));
+
+        osc::SquareWave<double> squareDouble(sr, f, 0.5, FFT_TEST_NUM_HARMONICS);
+        osc::FFTAdditiveEngine<double> engineDouble(sr);
+        engineDouble.SetPartials(squareDouble);
+        BlockReader<double, osc::FFTAdditiveEngine<double>> readerDouble(engineDouble,
+                                                                         ACCURACY_TEST_BLOCK_SIZE);
+        ExpectWithinThresholds(
+            MeasureAccuracy<double>(
+                readerDouble,
+                [&](size_t) {
+                    return WrapPhase(engineDouble.GetPhase(0) -
+                                     ReferencePhase(f, sr, readerDouble.uSamplesRendered));
+                },
+                vTones, sr, NUM_SAMPLES_FFT_ACCURACY_TEST),
+            GetThresholds<double>(KernelMode::FFT));
+    }
+}
+
+// Tests that AdditiveRenderer picks FFT synthesis only for high partial counts within
+// its accuracy budget, and keeps the ComplexWave in phase while using it.
+TEST(AdditiveFFTTest, CrossoverTest)
+{
+    // Calibrated crossovers for the default frame size
+    EXPECT_FALSE(osc::FFTAdditiveEngine<float>::ShouldUseFFT<float>(24));
+    EXPECT_TRUE(osc::FFTAdditiveEngine<float>::ShouldUseFFT<float>(25));
+    EXPECT_FALSE(osc::FFTAdditiveEngine<float>::ShouldUseFFT<double>(22));
+    EXPECT_TRUE(osc::FFTAdditiveEngine<float>::ShouldUseFFT<double>(23));
+
+    // Double waves only use FFT synthesis when they accept its accuracy, and never for
+    // fewer than MIN_FFT_PARTIALS partials.
+    EXPECT_FALSE(osc::FFTAdditiveEngine<double>::ShouldUseFFT<double>(1000));
+    EXPECT_FALSE(osc::FFTAdditiveEngine<double>::ShouldUseFFT<double>(15, 1024, 16, 60.0));
+    EXPECT_TRUE(osc::FFTAdditiveEngine<double>::ShouldUseFFT<double>(16, 1024, 16, 60.0));
+    EXPECT_FALSE(osc::FFTAdditiveEngine<float>::ShouldUseFFT<float>(1000, 1024, 16, 100.0));
+
+    osc::SquareWave<float, double> fewPartials(44100.0f, 440.0f, 1.0f, 10);
+    osc::AdditiveRenderer<float, double> directRenderer(fewPartials);
+    EXPECT_FALSE(directRenderer.IsUsingFFT());
+
+    osc::SquareWave<double> smallDouble(44100.0, 440.0, 1.0, 4);
+    osc::AdditiveRenderer<double> smallDoubleRenderer(smallDouble);
+    EXPECT_FALSE(smallDoubleRenderer.IsUsingFFT());
+
+    osc::SquareWave<FLOAT_T> manyPartials(44100.0, 10.0, 1.0, 500);
+    osc::SquareWave<FLOAT_T> control(44100.0, 10.0, 1.0, 500);
+    osc::AdditiveRenderer<FLOAT_T> accurateRenderer(manyPartials);
+    EXPECT_FALSE(accurateRenderer.IsUsingFFT());
+    osc::AdditiveRenderer<FLOAT_T> fftRenderer(manyPartials, 1024, 60.0);
+    EXPECT_TRUE(fftRenderer.IsUsingFFT());
+
+    std::vector<FLOAT_T> vBlock(1000);
+    fftRenderer.NextBlock(vBlock.data(), vBlock.size());
+    control.NextBlock(vBlock.data(), vBlock.size());
+    EXPECT_NEAR(manyPartials.GetSines().back().GetPhase(),
+                control.GetSines().back().GetPhase(), 1e-9);
+}
+
+// Tests that the Envelope moves through each stage and ends idle.
+TEST(EnvelopeTest, StageTest)
+{
+    osc::Envelope<FLOAT_T> envelope(1000.0, 0.01, 0.02, 0.5, 0.05);
+    EXPECT_TRUE(envelope.IsIdle());
+
+    envelope.NoteOn();
+    std::vector<FLOAT_T> vBlock(100, 1.0);
+    envelope.ProcessBlock(vBlock.data(), vBlock.size());
+
+    EXPECT_LT(vBlock[5], 1.0);
+    EXPECT_LE(*std::max_element(vBlock.begin(), vBlock.end()), 1.0);
+    EXPECT_GT(*std::max_element(vBlock.begin(), vBlock.end()), 0.95);
+    EXPECT_TRUE(envelope.GetStage() == osc::Envelope<FLOAT_T>::Stage::Sustain);
+    EXPECT_EQ(vBlock.back(), 0.5);
+
+    envelope.NoteOff();
+    vBlock.assign(1000, 1.0);
+    envelope.ProcessBlock(vBlock.data(), vBlock.size());
+    EXPECT_TRUE(envelope.IsIdle());
+    EXPECT_EQ(vBlock.back(), 0.0);
+}
+
+// Tests that the Envelope gives the same result regardless of block size.
+TEST(EnvelopeTest, BlockSizeTest)
+{
+    osc::Envelope<FLOAT_T> single(44100.0), block(44100.0);
+    single.NoteOn();
+    block.NoteOn();
+
+    std::vector<FLOAT_T> vSingle(44100, 1.0), vBlock(44100, 1.0);
+    for (size_t i{ 0 }; i < vSingle.size(); ++i)
+    {
+        if (i == 8192)
+            single.NoteOff();
+        single.ProcessBlock(&vSingle[i], 1);
+    }
+
+    for (size_t i{ 0 }; i < vBlock.size(); i += 64)
+    {
+        if (i == 8192)
+            block.NoteOff();
+        block.ProcessBlock(&vBlock[i], std::min<size_t>(64, vBlock.size() - i));
+    }
+
+    for (size_t i{ 0 }; i < vSingle.size(); ++i)
+        EXPECT_NEAR(vSingle[i], vBlock[i], 1e-9);
+    EXPECT_TRUE(single.IsIdle());
+    EXPECT_TRUE(block.IsIdle());
+}
+
+// Tests that an idle Voice does not run its oscillator.
+TEST(EnvelopeTest, IdleVoiceTest)
+{
+    osc::Voice<FLOAT_T, osc::SineWave<FLOAT_T>> voice({ 44100.0, 440.0 },
+                                                     { 44100.0, 0.001, 0.01, 0.5, 0.01 });
+    std::vector<FLOAT_T> vBlock(512);
+
+    EXPECT_TRUE(voice.NextBlock(vBlock.data(), vBlock.size()) == osc::BlockState::Silent);
+    EXPECT_EQ(voice.GetWave().GetPhase(), 0.0);
+
+    voice.NoteOn();
+    EXPECT_TRUE(voice.NextBlock(vBlock.data(), vBlock.size()) == osc::BlockState::Signal);
+    EXPECT_NE(voice.GetWave().GetPhase(), 0.0);
+
+    voice.NoteOff();
+    for (size_t i{ 0 }; i < 10 && !voice.IsIdle(); ++i)
+        voice.NextBlock(vBlock.data(), vBlock.size());
+    EXPECT_TRUE(voice.IsIdle());
+
+    const FLOAT_T phase{ voice.GetWave().GetPhase() };
+    EXPECT_TRUE(voice.NextBlock(vBlock.data(), vBlock.size()) == osc::BlockState::Silent);
+    EXPECT_EQ(voice.GetWave().GetPhase(), phase);
+}
+
+// Tests that silent oscillators report silent blocks while keeping their phase.
+TEST(BlockStateTest, SilenceTest)
+{
+    std::vector<FLOAT_T> vBlock(1000);
+
+    osc::SineWave<FLOAT_T> muted(44100.0, 440.0, 0.0), control(44100.0, 440.0, 1.0);
+    EXPECT_TRUE(muted.NextBlock(vBlock.data(), vBlock.size()) == osc::BlockState::Silent);
+    EXPECT_TRUE(control.NextBlock(vBlock.data(), vBlock.size()) == osc::BlockState::Signal);
+    EXPECT_NEAR(muted.GetPhase(), control.GetPhase(), 1e-12);
+
+    osc::SineWave<FLOAT_T> aboveNyquist(44100.0, 30000.0, 1.0);
+    EXPECT_TRUE(aboveNyquist.NextBlock(vBlock.data(), vBlock.size()) == osc::BlockState::Silent);
+    EXPECT_EQ(*std::max_element(vBlock.begin(), vBlock.end()), 0.0);
+
+    for (auto& sr : vSampleRates)
+        for (auto& n : vNumHarmonics)
+        {
+            osc::SquareWave<FLOAT_T> square(sr, vFrequencies.front(), 0.0, n);
+            EXPECT_TRUE(square.NextBlock(vBlock.data(), vBlock.size()) ==
+                        osc::BlockState::Silent);
+        }
+
+    osc::SquareWave<FLOAT_T> aliased(44100.0, 2000.0, 1.0, 10);
+    osc::SquareWave<FLOAT_T> aliasedControl(44100.0, 2000.0, 1.0, 10);
+    aliased.NextBlock(vBlock.data(), vBlock.size());
+    for (size_t i{ 0 }; i < vBlock.size(); ++i)
+        aliasedControl.NextSample();
+    EXPECT_TRUE(aliased.GetSines().back().IsSilent());
+    EXPECT_NEAR(aliased.GetSines().back().GetPhase(),
+                aliasedControl.GetSines().back().GetPhase(), 1e-9);
+
+    osc::Voice<FLOAT_T, osc::SineWave<FLOAT_T>> voice({ 44100.0, 440.0, 0.0 }, { 44100.0 });
+    voice.NoteOn();
+    EXPECT_TRUE(voice.NextBlock(vBlock.data(), vBlock.size()) == osc::BlockState::Silent);
+    EXPECT_GT(voice.GetEnvelope().GetLevel(), 0.0);
+}
+
+// Tests that mixing and conversion skip silent and constant blocks correctly.
+TEST(BlockStateTest, MixTest)
+{
+    const size_t uSize{ 64 };
+    std::vector<FLOAT_T> vMix(uSize, 0.0), vInput(uSize, 0.5);
+    osc::BlockState mixState{ osc::BlockState::Silent };
+
+    mixState = osc::MixBlock(vMix.data(), mixState, vInput.data(),
+                             osc::BlockState::Silent, uSize);
+    EXPECT_TRUE(mixState == osc::BlockState::Silent);
+    EXPECT_EQ(vMix.front(), 0.0);
+
+    mixState = osc::MixBlock(vMix.data(), mixState, vInput.data(),
+                             osc::BlockState::Constant, uSize, 2.0);
+    EXPECT_TRUE(mixState == osc::BlockState::Constant);
+    EXPECT_EQ(vMix.back(), 1.0);
+
+    std::vector<short> vPCM(uSize, 1);
+    osc::ConvertBlock(vMix.data(), mixState, vPCM.data(), uSize);
+    EXPECT_EQ(vPCM.back(), std::numeric_limits<short>::max());
+
+    osc::ConvertBlock(vMix.data(), osc::BlockState::Silent, vPCM.data(), uSize);
+    EXPECT_EQ(vPCM.front(), 0);
+}
+
+// Tests period detection and that cached replay matches direct rendering.
+TEST(CycleCacheTest, ReplayTest)
+{
+    const osc::Period period{ osc::FindPeriod(1000.0, 44100.0, 1e-9, 65536) };
+    EXPECT_EQ(period.uNumCycles, 10u);
+    EXPECT_EQ(period.uNumSamples, 441u);
+    EXPECT_EQ(osc::FindPeriod(1000.0 * M_PI, 44100.0, 1e-12, 65536).uNumSamples, 0u);
+
+    osc::CycleCache<FLOAT_T> cache;
+    const std::array<size_t, 4> vBlockSizes{ 1, 64, 500, 1000 };
+
+    osc::SineWave<FLOAT_T> sine(44100.0, 1000.0, 0.5), sineControl(sine);
+    osc::SquareWave<FLOAT_T> square(44100.0, 1000.0, 0.5, 9), squareControl(square);
+    osc::CachedWave<FLOAT_T, osc::SineWave<FLOAT_T>> cachedSine(sine, cache);
+    osc::CachedWave<FLOAT_T, osc::SquareWave<FLOAT_T>> cachedSquare(square, cache);
+    EXPECT_TRUE(cachedSine.IsCached());
+    EXPECT_TRUE(cachedSquare.IsCached());
+
+    std::vector<FLOAT_T> vCached(1000), vDirect(1000);
+    for (size_t i{ 0 }; i < 100; ++i)
+    {
+        const size_t uSize{ vBlockSizes[i % vBlockSizes.size()] };
+
+        if (i == 50)
+        {
+            // Parameter changes must fall back to, or re-enter, the cache seamlessly.
+            sine.SetFrequency(1234.5678);
+            sineControl.SetFrequency(1234.5678);
+            square.SetFrequency(2000.0);
+            squareControl.SetFrequency(2000.0);
+        }
+
+        cachedSine.NextBlock(vCached.data(), uSize);
+        sineControl.NextBlock(vDirect.data(), uSize);
+        for (size_t j{ 0 }; j < uSize; ++j)
+            ASSERT_NEAR(vCached[j], vDirect[j], 1e-9);
+
+        cachedSquare.NextBlock(vCached.data(), uSize);
+        squareControl.NextBlock(vDirect.data(), uSize);
+        for (size_t j{ 0 }; j < uSize; ++j)
+            ASSERT_NEAR(vCached[j], vDirect[j], 1e-9);
+    }
+    EXPECT_FALSE(cachedSine.IsCached());
+    EXPECT_TRUE(cachedSquare.IsCached());
+
+    // A wave entering the cache with a phase between the period's samples must not be
+    // snapped onto them.
+    osc::SineWave<FLOAT_T> offGrid(44100.0, 1234.5678, 1.0), offGridControl(offGrid);
+    osc::CachedWave<FLOAT_T, osc::SineWave<FLOAT_T>> cachedOffGrid(offGrid, cache);
+    cachedOffGrid.NextBlock(vCached.data(), 7);
+    offGridControl.NextBlock(vDirect.data(), 7);
+    for (FLOAT_T frequency : { 11025.0, 1000.0 })
+    {
+        offGrid.SetFrequency(frequency);
+        offGridControl.SetFrequency(frequency);
+        cachedOffGrid.NextBlock(vCached.data(), vCached.size());
+        offGridControl.NextBlock(vDirect.data(), vDirect.size());
+        EXPECT_FALSE(cachedOffGrid.IsCached());
+        for (size_t j{ 0 }; j < vCached.size(); ++j)
+            ASSERT_NEAR(vCached[j], vDirect[j], 1e-9);
+    }
+
+    osc::SineWave<FLOAT_T> shared(44100.0, 441.0, 1.0), sharedCopy(shared);
+    {
+        osc::CachedWave<FLOAT_T, osc::SineWave<FLOAT_T>> a(shared, cache), b(sharedCopy, cache);
+        EXPECT_EQ(cache.GetNumEntries(), 2u);
+    }
+    EXPECT_EQ(cache.GetNumEntries(), 1u);
+
+    // Threads acquiring the same period at once share a single rendering of it.
+    osc::SquareWave<FLOAT_T> contended(44100.0, 3.0, 1.0, 200);
+    const osc::CycleDescription description{ osc::DescribeCycle(contended) };
+    std::vector<osc::CycleCache<FLOAT_T>::Cycle> vCycles(8);
+    std::vector<std::thread> vThreads;
+    for (auto& cycle : vCycles)
+        vThreads.emplace_back([&]() { cycle = cache.Acquire(description); });
+    for (auto& t : vThreads)
+        t.join();
+    ASSERT_TRUE(vCycles.front().pSamples);
+    for (auto& cycle : vCycles)
+        EXPECT_EQ(cycle.pSamples, vCycles.front().pSamples);
+}
+
+// Tests that events inside a block take effect on exactly the scheduled sample.
+TEST(EventTest, SampleAccuracyTest)
+{
+    const size_t uSize{ 1000 };
+    std::vector<FLOAT_T> vBlock(uSize);
+
+    osc::SineWave<FLOAT_T> sine(44100.0, 440.0, 1.0), control(sine);
+    osc::EventList events, carried;
+    events.Add(700, osc::EventType::Amplitude, 0.25);
+    events.Add(300, osc::EventType::Frequency, 880.0);
+    events.Add(300, osc::EventType::Frequency, 1000.0);
+    EXPECT_EQ(events.begin()->value, 880.0);
+
+    osc::RenderBlock(sine, vBlock.data(), uSize, events, carried);
+    for (size_t i{ 0 }; i < uSize; ++i)
+    {
+        if (i == 300) control.SetFrequency(1000.0);
+        if (i == 700) control.SetAmplitude(0.25);
+        ASSERT_NEAR(vBlock[i], control.NextSample(), 1e-9);
+    }
+
+    osc::SquareWave<FLOAT_T> square(44100.0, 100.0, 1.0, 3), squareControl(square);
+    events.Clear();
+    events.Add(500, osc::EventType::NumHarmonics, 8);
+    events.Add(250, osc::EventType::Frequency, 200.0);
+    events.Add(uSize, osc::EventType::Amplitude, 0.5);
+    events.Add(uSize + 50, osc::EventType::Frequency, 300.0);
+
+    osc::RenderBlock(square, vBlock.data(), uSize, events, carried);
+    for (size_t i{ 0 }; i < uSize; ++i)
+    {
+        if (i == 250) squareControl.SetFrequency(200.0);
+        if (i == 500) squareControl.SetNumHarmonics(8);
+        ASSERT_NEAR(vBlock[i], squareControl.NextSample(), 1e-9);
+    }
+    EXPECT_EQ(square.GetNumHarmonics(), 8u);
+    EXPECT_EQ(square.GetSines().back().GetFrequency(), 17 * 200.0);
+    EXPECT_EQ(square.GetAmplitude(), 0.5);
+    EXPECT_EQ(square.GetFrequency(), 200.0);
+    ASSERT_EQ(carried.Size(), 1u);
+    EXPECT_EQ(carried.begin()->uOffset, 50u);
+    EXPECT_EQ(carried.begin()->value, 300.0);
+
+    osc::Voice<FLOAT_T, osc::SineWave<FLOAT_T>> voice({ 44100.0, 440.0, 1.0 }, { 44100.0 });
+    events.Clear();
+    events.Add(100, osc::EventType::NoteOn);
+    EXPECT_TRUE(osc::RenderBlock(voice, vBlock.data(), uSize, events, carried) ==
+                osc::BlockState::Signal);
+    EXPECT_EQ(*std::max_element(vBlock.begin(), vBlock.begin() + 100), 0.0);
+    EXPECT_GT(*std::max_element(vBlock.begin() + 100, vBlock.end()), 0.0);
+
+    osc::SquareWave<FLOAT_T> additive(44100.0, 10.0, 1.0, 100);
+    osc::Voice<FLOAT_T, osc::AdditiveRenderer<FLOAT_T>> additiveVoice({ additive, 1024, 60.0 },
+                                                                      { 44100.0 });
+    EXPECT_TRUE(additiveVoice.GetWave().IsUsingFFT());
+    events.Clear();
+    events.Add(0, osc::EventType::NoteOn);
+    events.Add(500, osc::EventType::NumHarmonics, 0);
+    osc::RenderBlock(additiveVoice, vBlock.data(), uSize, events, carried);
+    EXPECT_EQ(additive.GetNumHarmonics(), 0u);
+    EXPECT_FALSE(additiveVoice.GetWave().IsUsingFFT());
+
+    osc::CycleCache<FLOAT_T> cache;
+    osc::SineWave<FLOAT_T> cachedSine(44100.0, 1000.0, 1.0), cachedControl(cachedSine);
+    osc::CachedWave<FLOAT_T, osc::SineWave<FLOAT_T>> cached(cachedSine, cache);
+    events.Clear();
+    events.Add(10, osc::EventType::Frequency, 1500.0);
+    osc::RenderBlock(cached, vBlock.data(), uSize, events, carried);
+    for (size_t i{ 0 }; i < uSize; ++i)
+    {
+        if (i == 10) cachedControl.SetFrequency(1500.0);
+        ASSERT_NEAR(vBlock[i], cachedControl.NextSample(), 1e-9);
+    }
+    EXPECT_EQ(cachedSine.GetFrequency(), 1500.0);
+}
+
+// Tests that batch jobs are rendered, deduplicated and streamed to disk correctly.
+TEST(BatchRendererTest, ManifestTest)
+{
+    const std::filesystem::path dir{ std::filesystem::temp_directory_path() };
+    const std::string tone{ (dir / "osc_batch_tone.raw").string() };
+    const std::string copy{ (dir / "osc_batch_copy.raw").string() };
+    const std::string sweep{ (dir / "osc_batch_sweep.raw").string() };
+
+    std::istringstream manifest(
+        "# name waveform sampleRate frequency amplitude numHarmonics numSamples output\n"
+        "\n"
+        "tone square 48000 1000 0.5 6 10001 " + tone + "\n"
+        "copy square 48000 1000 0.5 6 10001 " + copy + "\n"
+        "sweep sine 44100 20 1.0 0 20000 " + sweep + " 20000\n");
+
+    std::vector<osc::RenderJob> vJobs;
+    std::string error;
+    ASSERT_TRUE(osc::ParseManifest(manifest, vJobs, error));
+    ASSERT_EQ(vJobs.size(), 3u);
+    EXPECT_EQ(vJobs[2].sweepFrequency, 20000.0);
+
+    for (const char* line : { "bad triangle 44100 100 1 0 100 out.raw",
+                              "bad sine 44100 100 1 -1 100 out.raw",
+                              "bad sine 44100 100 1 0 -100 out.raw",
+                              "bad sine 0 100 1 0 100 out.raw",
+                              "bad sine 44100 -100 1 0 100 out.raw",
+                              "bad sine 44100 100 1 0 100 out.raw fast",
+                              "bad sine 44100 100 1 0 100 out.raw 200 extra",
+                              "bad sine 44100 100x 1 0 100 out.raw",
+                              "bad sine 44100 100 1 0 100" })
+    {
+        std::istringstream invalid(line);
+        EXPECT_FALSE(osc::ParseManifest(invalid, vJobs, error)) << line;
+        EXPECT_FALSE(error.empty());
+        error.clear();
+    }
+    EXPECT_EQ(vJobs.size(), 3u);
+
+    osc::BatchRenderer<FLOAT_T> renderer(2, 1000);
+    const std::vector<osc::JobReport> vReports{ renderer.Run(vJobs) };
+    ASSERT_EQ(vReports.size(), 3u);
+    for (auto& report : vReports)
+        EXPECT_TRUE(report.bSucceeded);
+    EXPECT_FALSE(vReports[0].bReused);
+    EXPECT_TRUE(vReports[1].bReused);
+
+    auto read = [](const std::string& _path) {
+        std::ifstream is(_path, std::ios::binary);
+        std::vector<FLOAT_T> vSamples(std::filesystem::file_size(_path) / sizeof(FLOAT_T));
+        is.read(reinterpret_cast<char*>(vSamples.data()), vSamples.size() * sizeof(FLOAT_T));
+        return vSamples;
+    };
+
+    const std::vector<FLOAT_T> vTone{ read(tone) };
+    ASSERT_EQ(vTone.size(), 10001u);
+    EXPECT_TRUE(read(copy) == vTone);
+
+    // The sweep is a staircase with steps on every multiple of SWEEP_STEP samples.
+    const std::vector<FLOAT_T> vSweep{ read(sweep) };
+    ASSERT_EQ(vSweep.size(), 20000u);
+    osc::SineWave<FLOAT_T, double> sweepControl(44100.0, 20.0, 1.0);
+    for (size_t i{ 0 }; i < vSweep.size(); ++i)
+    {
+        if (i % osc::BatchRenderer<FLOAT_T>::SWEEP_STEP == 0)
+            sweepControl.SetFrequency(20.0 * std::pow(1000.0, (double)i / vSweep.size()));
+        ASSERT_NEAR(vSweep[i], sweepControl.NextSample(), 1e-9) << i;
+    }
+    EXPECT_GT(sweepControl.GetFrequency(), 19000.0);
+
+    osc::SquareWave<FLOAT_T> control(48000.0, 1000.0, 0.5, 6);
+    for (auto& sample : vTone)
+        ASSERT_NEAR(sample, control.NextSample(), 1e-9);
+
+    // Jobs with different parameters must not write the same file at once.
+    std::vector<osc::RenderJob> vClashing(2, vJobs[0]);
+    vClashing[1].frequency = 2000.0;
+    const std::vector<osc::JobReport> vClashReports{ renderer.Run(vClashing) };
+    EXPECT_TRUE(vClashReports[0].bSucceeded);
+    EXPECT_FALSE(vClashReports[1].bSucceeded);
+    EXPECT_TRUE(read(tone) == vTone);
+
+    for (auto& path : { tone, copy, sweep })
+        std::filesystem::remove(path);
+}